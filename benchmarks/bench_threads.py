@@ -0,0 +1,55 @@
+"""Measure how scalar xldt calls scale across threads.
+
+On a free-threaded CPython (3.13t and later) the throughput should grow
+with the number of threads up to the number of cores. On a standard build
+the GIL serializes the calls and the throughput stays flat.
+
+Usage: python benchmarks/bench_threads.py [calls_per_thread] [max_threads]
+"""
+
+import os
+import sys
+import threading
+import time
+import xldt
+
+def work(n, barrier):
+    barrier.wait()
+    for v in range(n):
+        xldt.year(v)
+        xldt.month(v)
+        xldt.day(v)
+        xldt.weekday(v, xldt.MON_1)
+        xldt.isoweek(v)
+
+def run(n_threads, n_calls):
+    barrier = threading.Barrier(n_threads + 1)
+    threads = [threading.Thread(target=work, args=(n_calls, barrier))
+               for _ in range(n_threads)]
+    for t in threads:
+        t.start()
+    barrier.wait()
+    start = time.perf_counter()
+    for t in threads:
+        t.join()
+    return time.perf_counter() - start
+
+def main():
+    n_calls = int(sys.argv[1]) if len(sys.argv) > 1 else 200000
+    max_threads = int(sys.argv[2]) if len(sys.argv) > 2 else os.cpu_count()
+    is_gil_enabled = getattr(sys, '_is_gil_enabled', lambda: True)()
+    print('python {} (GIL {})'.format(sys.version.split()[0],
+          'enabled' if is_gil_enabled else 'disabled'))
+    base = None
+    n_threads = 1
+    while n_threads <= max_threads:
+        elapsed = run(n_threads, n_calls)
+        rate = 5 * n_calls * n_threads / elapsed
+        if base is None:
+            base = rate
+        print('{:3d} threads: {:12.0f} calls/s, speedup {:5.2f}'.format(
+              n_threads, rate, rate / base))
+        n_threads *= 2
+
+if __name__ == '__main__':
+    main()
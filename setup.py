@@ -1,4 +1,6 @@
+import os
 import setuptools
+from setuptools.command.build_ext import build_ext
 
 xldt_description = None
 
@@ -7,6 +9,23 @@ with open("README.md", "r", encoding="utf-8") as f:
 
 xldt_keywords = ["python", "excel", "date", "time"]
 
+# The instrumentation of the functions is compiled only on request.
+xldt_macros = []
+if os.environ.get("XLDT_STATS"):
+    xldt_macros.append(("XLDT_STATS", None))
+if os.environ.get("XLDT_STATS_LATENCY"):
+    xldt_macros.append(("XLDT_STATS_LATENCY", None))
+
+
+class xldt_build_ext(build_ext):
+    """Build the static calendar core before the extension linking it, so
+    that build_ext also works alone (like build_ext --inplace)."""
+
+    def run(self):
+        self.run_command("build_clib")
+        super().run()
+
+
 setuptools.setup(name="xldt",
     version="0.3.0",
     author="Vlad Tudorache",
@@ -17,9 +36,16 @@ setuptools.setup(name="xldt",
     url="https://github.com/vtudorache/xldt",
     classifiers=[
         "Programming Language :: C",
+        "Programming Language :: Python :: Free Threading :: 2 - Beta",
         "License :: OSI Approved :: MIT License"
     ],
     keywords = " ".join(xldt_keywords),
-    ext_modules=[setuptools.Extension("xldt", ["src/xldt.c"])],
+    libraries=[("xldt_core", {"sources": ["src/xldt_core.c",
+                                                "src/xldt_codec.c"]})],
+    ext_modules=[setuptools.Extension("xldt",
+                                      ["src/xldt.c", "src/xldt_array.c",
+                                       "src/xldt_fiscal.c"],
+                                      define_macros=xldt_macros)],
+    cmdclass={"build_ext": xldt_build_ext},
     python_requires=">=3.6"
 )
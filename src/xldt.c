@@ -1,334 +1,19 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <ctype.h>
+#include <math.h>
 #include <time.h>
+#include <datetime.h>
 
+#include "xldt_array.h"
+#include "xldt_batch.h"
+#include "xldt_capi.h"
+#include "xldt_codec.h"
+#include "xldt_core.h"
 #include "xldt_doc.h"
+#include "xldt_fiscal.h"
 #include "xldt_msg.h"
-
-/* 
-** A base year y must be chosen so that y % 400 == 1. It must be lesser
-** than the base year used by Excel (1900).
-*/
-#define BASE_YEAR 1601
-
-/*
-** A normal year has 365 days. Every 4th year is leap if it's not multiple
-** of 100 or if it's multiple of 400. A leap year has 366 days.
-** The second month has 28 days in a normal year, 29 days in a leap year.
-*/
-#define IS_LEAP(y) ((y) % 4 == 0 && (y) % 100 != 0 || (y) % 400 == 0)
-
-/*
-** A cycle of 4 years has 365 * 3 + 366 = 4 * 365 + 1 = 1461 days.
-** The last year of every 25th cycle of 4 years is a multiple of 100, so it
-** isn't leap, it has one day less.
-** A cycle of 100 years has 25 * 1461 - 1 = 36524 days.
-** The last year of every 4th cycle of 100 years is a multiple of 400, so
-** it's leap, it has one more day.
-** A cycle of 400 years has 4 * 36524 + 1 = 146097 days.
-*/
-#define DAYS_IN_YEAR      365
-#define DAYS_IN_4_YEARS   1461
-#define DAYS_IN_100_YEARS 36524
-#define DAYS_IN_400_YEARS 146097
-
-/*
-** The DAYS_IN_YEARS macro calculates the number of full days in the given
-** number of years starting with the 1st January of the BASE_YEAR.
-** The argument must be greater than or equal to 0.
-*/
-#define DAYS_IN_YEARS(n) ((n) * 365 + (n) / 400 - (n) / 100 + (n) / 4)
-
-/*
-** The calendar assigns a serial number to each date.
-** The serial number 1 represents 1899-12-31, so that the numbers produced
-** by this module are identical with those produced by Excel for dates
-** starting with 1900-03-01 when using the 1900 based date system (the
-** identity is lost for previous dates because of Lotus bug, also present
-** in Excel).
-** The base offset is the difference in days between the date corresponding
-** to the serial number 1 and 1st January of BASE_YEAR. It is used for
-** internal calculations.
-*/
-#define BASE_OFFSET (DAYS_IN_YEARS(1900 - BASE_YEAR) - 1)
-
-/*
-** Every year has 12 months.
-*/
-#define MONTHS_IN_YEAR 12
-/*
-** The number of days contained in the given number of months of a non-leap
-** year is stored in the array below.
-*/
-static long DAYS_IN_MONTHS[] = {
-    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365
-};
-
-/*
-** Every week has 7 days.
-*/
-#define DAYS_IN_WEEK 7
-
-/*
-** A day has 24 hours, an hour has 60 minutes, a minute has 60 seconds, so
-** an hour has 3600 seconds, a day has 1440 minutes or 86400 seconds.
-*/
-#define HOURS_IN_DAY      24
-#define MINUTES_IN_HOUR   60
-#define MINUTES_IN_DAY    1440
-#define SECONDS_IN_MINUTE 60
-#define SECONDS_IN_HOUR   3600
-#define SECONDS_IN_DAY    86400
-
-/*
-** Return the nearest lesser integer regardless of the sign of the value.
-*/
-static long
-x_floor(double v)
-{
-    return (long)floor(v);
-}
-
-/*
-** Round to the nearest integer when the decimal part is not 0.5 and to the
-** nearest even integer when the decimal part is exactly 0.5.
-*/
-static long
-x_round(double v)
-{
-    long x = (long)round(v);
-    if (x < v) {
-        double d = v - x;
-        if (d > 0.5 || (d == 0.5 && x % 2 != 0)) {
-            return x + 1;
-        }
-    }
-    else if (x > v) {
-        double d = x - v;
-        if (d > 0.5 || (d == 0.5 && x % 2 != 0)) {
-            return x - 1;
-        }
-    }
-    return x;
-}
-
-/*
-** Return the quotient of the Euclidean division between n and d.
-*/
-static long
-x_quotient(long n, long d)
-{
-    if (n < 0) {
-        if (d < 0) {
-            return (- n - 1) / (- d) + 1;
-        }
-        return - ((- n - 1) / d) - 1;
-    }
-    if (d < 0) {
-        return - (n / (- d));
-    }
-    return n / d;
-}
-
-/*
-** Return the remainder of the Euclidean division between n and d.
-*/
-static long
-x_remainder(long n, long d)
-{
-    return n - d * x_quotient(n, d);
-}
-
-/*
-** Return the number of days passed between the 1st January BASE_YEAR and
-** the 1st January of the given year. The result is negative for the years
-** before BASE_YEAR.
-*/
-static long
-days_before_year(long year)
-{
-    long n_cycles = 0, n_days = 0, n_years = year - BASE_YEAR;
-    if (n_years < 0) {
-        n_cycles = x_quotient(n_years, 400);
-        n_years -= n_cycles * 400;
-        n_days += n_cycles * DAYS_IN_400_YEARS;
-    }
-    return n_days + DAYS_IN_YEARS(n_years);
-}
-
-/*
-** Return the number of days passed between the 1st January and the 1st of
-** the given month (1 - 12) of the year.
-** Return -1 if the month number isn't valid.
-*/
-static long
-year_days_before_month(long year, long month)
-{
-    long days = -1;
-    if (month >= 1 || month <= MONTHS_IN_YEAR) {
-        days = DAYS_IN_MONTHS[month - 1];
-        if (month > 2 && IS_LEAP(year)) {
-            days += 1;
-        }
-    }
-    return days;
-}
-
-/*
-** Write the year, month and day corresponding to the serial number at the
-** addresses given as arguments (can't be NULL).
-*/
-static void
-serial_to_date(long serial, long *year, long *month, long *day)
-{
-    long n, n_days;
-    /* Translate to absolute serial (where 1 is 1st January of BASE_YEAR) */
-    serial += BASE_OFFSET;
-    n_days = serial - 1;
-    *year = BASE_YEAR;
-    n = x_quotient(n_days, DAYS_IN_400_YEARS);
-    *year += n * 400;
-    n_days -= n * DAYS_IN_400_YEARS;
-    n = x_quotient(n_days, DAYS_IN_100_YEARS);
-    n -= n >> 2;
-    *year += n * 100;
-    n_days -= n * DAYS_IN_100_YEARS;
-    n = x_quotient(n_days, DAYS_IN_4_YEARS);
-    *year += n * 4;
-    n_days -= n * DAYS_IN_4_YEARS;
-    n = x_quotient(n_days, DAYS_IN_YEAR);
-    n -= n >> 2;
-    *year += n;
-    n_days -= n * DAYS_IN_YEAR;
-    *month = 1 + n_days / 31;
-    if (*month < MONTHS_IN_YEAR && 
-        n_days >= year_days_before_month(*year, *month + 1)) 
-    {
-        *month += 1;
-    }
-    n_days -= year_days_before_month(*year, *month);
-    *day = n_days + 1;
-}
-
-/*
-** Return the serial corresponding to the given year, month and day, so that
-** 1 corresponds to 1899-12-31.
-*/
-static long
-date_as_serial(long year, long month, long day)
-{
-    if (month < 1 || month > MONTHS_IN_YEAR) {
-        long n_years;
-        n_years = x_quotient(month - 1, MONTHS_IN_YEAR);
-        year += n_years;
-        month -= n_years * MONTHS_IN_YEAR;
-    }
-    day += year_days_before_month(year, month);
-    day += days_before_year(year);
-    /* Return translation from absolute serial */
-    return day - BASE_OFFSET;
-}
-
-#define SUN_1 1
-#define MON_1 2
-#define MON_0 3
-#define MON_1_EXT 11
-#define TUE_1_EXT 12
-#define WED_1_EXT 13
-#define THU_1_EXT 14
-#define FRI_1_EXT 15
-#define SAT_1_EXT 16
-#define SUN_1_EXT 17
-
-/*
-** Return the weekday according to the week type values defined above.
-** Return -1 if the type isn't valid.
-*/
-static long
-serial_as_weekday(long serial, long type)
-{
-    /*
-    ** Since the 1st January 2001 was a Monday and 2001 is a first year of
-    ** a cycle, BASE_YEAR (which must be a first year of a cycle) has the
-    ** 1st January on a Monday.
-    ** It is at BASE_OFFSET days before the date represented by serial 1.
-    */
-    long base = 1 - BASE_OFFSET, days;
-    /* Translate the base according to the required result type. */
-    if (type == SUN_1) {
-        base -= 1;
-    }
-    else if (MON_1_EXT <= type && type <= SUN_1_EXT) {
-        base += type - MON_1_EXT;
-    }
-    else if (type != MON_0 && type != MON_1) {
-        return -1;
-    }
-    days = serial - base;
-    days = x_remainder(days, DAYS_IN_WEEK);
-    if (type == MON_0) {
-        return days;
-    }
-    return days + 1;
-}
-
-#define MON_2 21
-
-/*
-** Return the week number according to the week type value defined above or
-** to the values used by the 'serial_as_weekday' function.
-** Return 0 if the type isn't valid.
-*/
-static long
-serial_as_week(long serial, long type)
-{
-    long base, day, last, month, year;
-    serial_to_date(serial, &year, &month, &day);
-    if (type == SUN_1 || 
-        type == MON_1 || (type >= MON_1_EXT && type <= SUN_1_EXT))
-    {
-        base = date_as_serial(year, 1, 1);
-        base -= serial_as_weekday(base, type) - 1;
-        return (serial - base) / DAYS_IN_WEEK + 1;
-    }
-    if (type == MON_2) {
-        long wday;
-        /* Find the Monday of the ISO week 1 of the year. */
-        base = date_as_serial(year, 1, 1);
-        wday = serial_as_weekday(base, MON_1);
-        if (wday <= 4) {
-            base -= wday - 1;
-        }
-        else {
-            base += DAYS_IN_WEEK - wday + 1;
-        }
-        if (serial < base) {
-            base = date_as_serial(year - 1, 1, 1);
-            wday = serial_as_weekday(base, MON_1);
-            if (wday <= 4) {
-                base -= wday - 1;
-            }
-            else {
-                base += DAYS_IN_WEEK - wday + 1;
-            }
-        }
-        else {
-            last = date_as_serial(year, 12, 31);
-            wday = serial_as_weekday(last, SUN_1);
-            if (wday <= 4) {
-                last -= wday - 1;
-            }
-            else {
-                last += DAYS_IN_WEEK - wday + 1;
-            }
-            if (serial > last) {
-                return 1;
-            }
-        }
-        return (serial - base) / DAYS_IN_WEEK + 1;
-    }
-    return 0;
-}
+#include "xldt_stats.h"
 
 static PyObject *
 xldt_year(PyObject *self, PyObject *args)
@@ -377,7 +62,6 @@ add_week_types(PyObject *module)
         PyModule_AddIntMacro(module, MON_0) < 0 ||
         PyModule_AddIntMacro(module, MON_2) < 0)
     {
-        Py_DECREF(module);
         return NULL;
     }
     if (PyModule_AddIntMacro(module, MON_1_EXT) < 0 ||
@@ -388,7 +72,6 @@ add_week_types(PyObject *module)
         PyModule_AddIntMacro(module, SAT_1_EXT) < 0 ||
         PyModule_AddIntMacro(module, SUN_1_EXT) < 0)
     {
-        Py_DECREF(module);
         return NULL;
     }
     return module;
@@ -410,6 +93,148 @@ xldt_weekday(PyObject *self, PyObject *args)
     return PyLong_FromLong(day);
 }
 
+/*
+** Return the value of the date, the months and the days out of their range
+** being carried to the years and the months like Excel's DATE does.
+*/
+static double
+components_as_date(double year, double month, double day)
+{
+    return date_as_serial((long)year, (long)month, (long)day);
+}
+
+/*
+** Return the value of the time of the day, wrapped to a day like Excel's
+** TIME does.
+*/
+static double
+components_as_time(double hour, double minute, double second)
+{
+    minute += hour * MINUTES_IN_HOUR;
+    second += minute * SECONDS_IN_MINUTE;
+    second = x_remainder((long)second, SECONDS_IN_DAY);
+    return second / SECONDS_IN_DAY;
+}
+
+/*
+** The number of items converted at once by the batches of dates and times.
+*/
+#define COMPONENTS_CHUNK 256
+
+/*
+** Write the values of the n dates starting at the item start of the
+** components in values, through the 'dates_as_serials' kernel of the C API.
+** Return -1 with an exception set if a component isn't valid.
+*/
+static int
+components_as_dates(const batch_arg *components, Py_ssize_t start,
+                    Py_ssize_t n, double *values)
+{
+    long years[COMPONENTS_CHUNK], months[COMPONENTS_CHUNK];
+    long days[COMPONENTS_CHUNK], serials[COMPONENTS_CHUNK];
+    Py_ssize_t i;
+    if (batch_arg_longs(&components[0], start, n, years) < 0 ||
+        batch_arg_longs(&components[1], start, n, months) < 0 ||
+        batch_arg_longs(&components[2], start, n, days) < 0)
+    {
+        return -1;
+    }
+    dates_as_serials(years, months, days, (size_t)n, serials);
+    for (i = 0; i < n; i++) {
+        values[i] = (double)serials[i];
+    }
+    return 0;
+}
+
+/*
+** Write the values of the n times starting at the item start of the
+** components in values. The components stay floats, the fractions of the
+** hours and of the minutes being carried to the seconds like 'xldt_time'
+** does. Return -1 with an exception set if a component isn't a number.
+*/
+static int
+components_as_times(const batch_arg *components, Py_ssize_t start,
+                    Py_ssize_t n, double *values)
+{
+    Py_ssize_t i;
+    int j;
+    for (i = 0; i < n; i++) {
+        double v[3];
+        for (j = 0; j < 3; j++) {
+            v[j] = batch_arg_item(&components[j], start + i);
+            if (v[j] == -1.0 && PyErr_Occurred()) {
+                return -1;
+            }
+        }
+        values[i] = components_as_time(v[0], v[1], v[2]);
+    }
+    return 0;
+}
+
+/*
+** The implementation of dates and times, which convert the components
+** chunk by chunk with the function. The items of the components which
+** aren't numbers must have the same size. The result is a float if all
+** the components are numbers.
+*/
+static PyObject *
+components_as_values(PyObject *args, PyObject *kwargs, char **keywords,
+                     PyObject *a_second, PyObject *a_third,
+                     int (*convert)(const batch_arg *, Py_ssize_t,
+                                    Py_ssize_t, double *),
+                     int stats_index)
+{
+    PyObject *objects[3] = {NULL, a_second, a_third}, *a_out = Py_None;
+    batch_arg components[3];
+    batch_out out;
+    Py_ssize_t i, size;
+    int j, n_args = 0, failed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOO", keywords,
+                                     &objects[0], &objects[1], &objects[2],
+                                     &a_out))
+    {
+        return NULL;
+    }
+    for (j = 0; j < 3; j++) {
+        if (batch_arg_init(&components[j], objects[j], keywords[j]) < 0) {
+            break;
+        }
+        n_args += 1;
+    }
+    size = n_args < 3 ? -2 : batch_size(components, 3);
+    if (size == -1) {
+        double value;
+        if (batch_out_none(a_out) < 0 ||
+            convert(components, 0, 1, &value) < 0)
+        {
+            return NULL;
+        }
+        return PyFloat_FromDouble(value);
+    }
+    if (size < 0 || batch_out_init(&out, a_out, size, 'd') < 0) {
+        while (n_args > 0) {
+            batch_arg_release(&components[--n_args]);
+        }
+        return NULL;
+    }
+    for (i = 0; i < size && !failed; i += COMPONENTS_CHUNK) {
+        double values[COMPONENTS_CHUNK];
+        Py_ssize_t k, n = size - i;
+        if (n > COMPONENTS_CHUNK) {
+            n = COMPONENTS_CHUNK;
+        }
+        failed = convert(components, i, n, values) < 0;
+        for (k = 0; k < n && !failed; k++) {
+            failed = batch_out_set(&out, i + k, values[k]) < 0;
+        }
+    }
+    STATS_BATCH(stats_index, size);
+    for (j = 0; j < 3; j++) {
+        batch_arg_release(&components[j]);
+    }
+    return batch_out_finish(&out, failed);
+}
+
 static PyObject *
 xldt_date(PyObject *self, PyObject *args)
 {
@@ -417,9 +242,21 @@ xldt_date(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "d|dd", &a_year, &a_month, &a_day)) {
         return NULL;
     }
-    return PyFloat_FromDouble(date_as_serial((long)a_year, 
-                                             (long)a_month, 
-                                             (long)a_day));
+    return PyFloat_FromDouble(components_as_date(a_year, a_month, a_day));
+}
+
+static PyObject *
+xldt_dates(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"years", "months", "days", "out", NULL};
+    PyObject *one = PyLong_FromLong(1), *result;
+    if (one == NULL) {
+        return NULL;
+    }
+    result = components_as_values(args, kwargs, keywords, one, one,
+                                  components_as_dates, STATS_DATES);
+    Py_DECREF(one);
+    return result;
 }
 
 static PyObject *
@@ -465,10 +302,21 @@ xldt_time(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "d|dd", &a_hour, &a_minute, &a_second)) {
         return NULL;
     }
-    a_minute += a_hour * MINUTES_IN_HOUR;
-    a_second += a_minute * SECONDS_IN_MINUTE;
-    a_second = x_remainder((long)a_second, SECONDS_IN_DAY);
-    return PyFloat_FromDouble(a_second / SECONDS_IN_DAY);
+    return PyFloat_FromDouble(components_as_time(a_hour, a_minute, a_second));
+}
+
+static PyObject *
+xldt_times(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"hours", "minutes", "seconds", "out", NULL};
+    PyObject *zero = PyLong_FromLong(0), *result;
+    if (zero == NULL) {
+        return NULL;
+    }
+    result = components_as_values(args, kwargs, keywords, zero, zero,
+                                  components_as_times, STATS_TIMES);
+    Py_DECREF(zero);
+    return result;
 }
 
 static PyObject *
@@ -485,42 +333,198 @@ static PyObject *
 xldt_months(PyObject *self, PyObject *args)
 {
     double a_start, a_end;
-    long start_year, start_month, start_day;
-    long end_year, end_month, end_day;
-    long delta;
+    date_fields start, end;
     if (!PyArg_ParseTuple(args, "dd", &a_start, &a_end)) {
         return NULL;
     }
-    serial_to_date(x_floor(a_start), &start_year, &start_month,
-                   &start_day);
-    serial_to_date(x_floor(a_end), &end_year, &end_month,
-                   &end_day);
-    delta = (end_year - start_year) * 12 + end_month - start_month;
-    if (start_day > end_day) {
-        delta -= 1;
-    }
-    return PyLong_FromLong(delta);
+    serial_to_fields(x_floor(a_start), &start);
+    serial_to_fields(x_floor(a_end), &end);
+    return PyLong_FromLong(fields_difference(&start, &end, DIF_M));
 }
 
 static PyObject *
 xldt_years(PyObject *self, PyObject *args)
 {
     double a_start, a_end;
-    long start_year, start_month, start_day;
-    long end_year, end_month, end_day;
-    long delta;
+    date_fields start, end;
     if (!PyArg_ParseTuple(args, "dd", &a_start, &a_end)) {
         return NULL;
     }
-    serial_to_date(x_floor(a_start), &start_year, &start_month, &start_day);
-    serial_to_date(x_floor(a_end), &end_year, &end_month, &end_day);
-    delta = end_year - start_year;
-    if (start_month > end_month || (start_month == end_month &&
-                                    start_day > end_day))
+    serial_to_fields(x_floor(a_start), &start);
+    serial_to_fields(x_floor(a_end), &end);
+    return PyLong_FromLong(fields_difference(&start, &end, DIF_Y));
+}
+
+/*
+** The maximum number of units computed by one call of 'xldt_datedif'.
+*/
+#define DATEDIF_MAX_UNITS 6
+
+/*
+** Return the DIF_ value corresponding to the unit name (in any case).
+** Return 0 with an exception set if the name isn't valid.
+*/
+static long
+datedif_unit(PyObject *name)
+{
+    static const char *const names[] = {"D", "M", "Y", "MD", "YM", "YD"};
+    static const long units[] = {DIF_D, DIF_M, DIF_Y, DIF_MD, DIF_YM, DIF_YD};
+    char upper[3] = {0, 0, 0};
+    const char *text = NULL;
+    size_t i;
+    if (PyUnicode_Check(name)) {
+        text = PyUnicode_AsUTF8(name);
+        if (text == NULL) {
+            return 0;
+        }
+    }
+    if (text != NULL && strlen(text) <= 2) {
+        for (i = 0; text[i] != 0; i++) {
+            upper[i] = (char)toupper((unsigned char)text[i]);
+        }
+        for (i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+            if (strcmp(upper, names[i]) == 0) {
+                return units[i];
+            }
+        }
+    }
+    PyErr_Format(PyExc_ValueError, DATEDIF_UNIT_ERRMSG, name);
+    return 0;
+}
+
+static PyObject *
+xldt_datedif(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"start_date", "end_date", "unit", "out",
+                               NULL};
+    PyObject *a_start, *a_end, *a_unit, *a_out = Py_None;
+    PyObject *units_seq = NULL, *result = NULL;
+    batch_arg dates[2];
+    batch_out outs[DATEDIF_MAX_UNITS];
+    long units[DATEDIF_MAX_UNITS];
+    Py_ssize_t i, j, n_units = 1, size;
+    date_fields start, end;
+    int failed = 0, is_sequence;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|O", keywords,
+                                     &a_start, &a_end, &a_unit, &a_out))
     {
-        delta -= 1;
+        return NULL;
+    }
+    is_sequence = !PyUnicode_Check(a_unit);
+    if (is_sequence) {
+        units_seq = PySequence_Fast(a_unit, DATEDIF_UNITS_ERRMSG);
+        if (units_seq == NULL) {
+            return NULL;
+        }
+        n_units = PySequence_Fast_GET_SIZE(units_seq);
+        if (n_units > DATEDIF_MAX_UNITS) {
+            PyErr_Format(PyExc_ValueError, DATEDIF_UNIT_ERRMSG, a_unit);
+            Py_DECREF(units_seq);
+            return NULL;
+        }
+    }
+    for (j = 0; j < n_units; j++) {
+        PyObject *name = a_unit;
+        if (is_sequence) {
+            name = batch_sequence_item(units_seq, j);
+            if (name == NULL) {
+                Py_DECREF(units_seq);
+                return NULL;
+            }
+        }
+        units[j] = datedif_unit(name);
+        if (is_sequence) {
+            Py_DECREF(name);
+        }
+        if (units[j] == 0) {
+            Py_XDECREF(units_seq);
+            return NULL;
+        }
+    }
+    Py_XDECREF(units_seq);
+    if (batch_arg_init(&dates[0], a_start, "start_date") < 0) {
+        return NULL;
+    }
+    if (batch_arg_init(&dates[1], a_end, "end_date") < 0) {
+        batch_arg_release(&dates[0]);
+        return NULL;
+    }
+    size = batch_size(dates, 2);
+    if (size == -1) {
+        /* Both dates are scalars, the results are scalars too. */
+        if (batch_out_none(a_out) < 0) {
+            return NULL;
+        }
+        serial_to_fields(x_floor(dates[0].scalar), &start);
+        serial_to_fields(x_floor(dates[1].scalar), &end);
+        if (!is_sequence) {
+            return PyLong_FromLong(fields_difference(&start, &end,
+                                                     units[0]));
+        }
+        result = PyTuple_New(n_units);
+        for (j = 0; result != NULL && j < n_units; j++) {
+            PyObject *delta = PyLong_FromLong(
+                fields_difference(&start, &end, units[j]));
+            if (delta == NULL) {
+                Py_CLEAR(result);
+                break;
+            }
+            PyTuple_SET_ITEM(result, j, delta);
+        }
+        return result;
     }
-    return PyLong_FromLong(delta);
+    if (size < -1) {
+        batch_arg_release(&dates[0]);
+        batch_arg_release(&dates[1]);
+        return NULL;
+    }
+    if (is_sequence) {
+        failed = batch_outs_init(outs, n_units, a_out, size, 'q') < 0;
+    }
+    else {
+        failed = batch_out_init(&outs[0], a_out, size, 'q') < 0;
+    }
+    if (failed) {
+        batch_arg_release(&dates[0]);
+        batch_arg_release(&dates[1]);
+        return NULL;
+    }
+    /* A scalar date is decomposed only once. */
+    if (dates[0].kind == BATCH_SCALAR) {
+        serial_to_fields(x_floor(dates[0].scalar), &start);
+    }
+    if (dates[1].kind == BATCH_SCALAR) {
+        serial_to_fields(x_floor(dates[1].scalar), &end);
+    }
+    for (i = 0; i < size && !failed; i++) {
+        if (dates[0].kind != BATCH_SCALAR) {
+            double v = batch_arg_item(&dates[0], i);
+            if (v == -1.0 && PyErr_Occurred()) {
+                failed = 1;
+                break;
+            }
+            serial_to_fields(x_floor(v), &start);
+        }
+        if (dates[1].kind != BATCH_SCALAR) {
+            double v = batch_arg_item(&dates[1], i);
+            if (v == -1.0 && PyErr_Occurred()) {
+                failed = 1;
+                break;
+            }
+            serial_to_fields(x_floor(v), &end);
+        }
+        for (j = 0; j < n_units && !failed; j++) {
+            failed = batch_out_set(&outs[j], i, fields_difference(
+                &start, &end, units[j])) < 0;
+        }
+    }
+    STATS_BATCH(STATS_DATEDIF, size);
+    batch_arg_release(&dates[0]);
+    batch_arg_release(&dates[1]);
+    if (is_sequence) {
+        return batch_outs_finish(outs, n_units, failed);
+    }
+    return batch_out_finish(&outs[0], failed);
 }
 
 /*
@@ -552,9 +556,16 @@ xldt_now(PyObject *self, PyObject *args)
         PyErr_SetString(PyExc_OverflowError, TIME_T_SIZE_ERRMSG);
         return NULL;
     }
+    /*
+    ** Use the reentrant localtime_r, which writes into the local structure
+    ** instead of a static buffer shared between threads (localtime does),
+    ** so that concurrent calls are safe without the GIL.
+    */
     errno = 0;
-    if (localtime_r(&t, &now) == NULL && errno == 0) {
-        errno = EINVAL;
+    if (localtime_r(&t, &now) == NULL) {
+        if (errno == 0) {
+            errno = EINVAL;
+        }
         PyErr_SetFromErrno(PyExc_OSError);
         return NULL;
     }
@@ -608,19 +619,154 @@ xldt_isoweek(PyObject *self, PyObject *args)
     return PyLong_FromLong(week);
 }
 
-#define WE_SAT_SUN 1
-#define WE_SUN_MON 2
-#define WE_MON_TUE 3
-#define WE_TUE_WED 4
-#define WE_WED_THU 5
-#define WE_THU_FRI 6
-#define WE_FRI_SAT 7
-#define WE_SUN 11
-#define WE_MON 12
-#define WE_TUE 13
-#define WE_WED 14
-#define WE_THU 15
-#define WE_FRI 16
+static PyObject *
+xldt_isocalendar(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"value", "out", NULL};
+    PyObject *a_value, *a_out = Py_None;
+    batch_arg values;
+    batch_out outs[3];
+    Py_ssize_t i;
+    date_fields date;
+    long iso_year, iso_week;
+    int failed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", keywords,
+                                     &a_value, &a_out))
+    {
+        return NULL;
+    }
+    if (batch_arg_init(&values, a_value, "value") < 0) {
+        return NULL;
+    }
+    if (values.kind == BATCH_SCALAR) {
+        if (batch_out_none(a_out) < 0) {
+            return NULL;
+        }
+        serial_to_fields(x_floor(values.scalar), &date);
+        iso_week = fields_as_isoweek(&date, &iso_year);
+        return Py_BuildValue("(lll)", iso_year, iso_week,
+                             serial_as_weekday(date.serial, MON_1));
+    }
+    if (batch_outs_init(outs, 3, a_out, values.size, 'q') < 0) {
+        batch_arg_release(&values);
+        return NULL;
+    }
+    for (i = 0; i < values.size; i++) {
+        double v = batch_arg_item(&values, i);
+        if (v == -1.0 && PyErr_Occurred()) {
+            failed = 1;
+            break;
+        }
+        serial_to_fields(x_floor(v), &date);
+        iso_week = fields_as_isoweek(&date, &iso_year);
+        if (batch_out_set(&outs[0], i, iso_year) < 0 ||
+            batch_out_set(&outs[1], i, iso_week) < 0 ||
+            batch_out_set(&outs[2], i,
+                          serial_as_weekday(date.serial, MON_1)) < 0)
+        {
+            failed = 1;
+            break;
+        }
+    }
+    STATS_BATCH(STATS_ISOCALENDAR, values.size);
+    batch_arg_release(&values);
+    return batch_outs_finish(outs, 3, failed);
+}
+
+static PyObject *
+xldt_from_isocalendar(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"iso_year", "iso_week", "iso_weekday", "out",
+                               NULL};
+    PyObject *a_items[3] = {NULL, NULL, NULL}, *a_out = Py_None, *one;
+    static const char *const names[3] = {"iso_year", "iso_week",
+                                         "iso_weekday"};
+    batch_arg items[3];
+    batch_out out;
+    Py_ssize_t i, size;
+    long iso_year = 0, iso_week = 1, iso_weekday = 1;
+    int j, failed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOO", keywords,
+                                     &a_items[0], &a_items[1], &a_items[2],
+                                     &a_out))
+    {
+        return NULL;
+    }
+    /* The omitted week and weekday are 1, as the first day of the year. */
+    one = PyLong_FromLong(1);
+    if (one == NULL) {
+        return NULL;
+    }
+    for (j = 0; j < 3; j++) {
+        if (batch_arg_init(&items[j], a_items[j] != NULL ? a_items[j] : one,
+                           names[j]) < 0)
+        {
+            while (j > 0) {
+                j -= 1;
+                batch_arg_release(&items[j]);
+            }
+            Py_DECREF(one);
+            return NULL;
+        }
+    }
+    Py_DECREF(one);
+    size = batch_size(items, 3);
+    if (size == -1) {
+        if (batch_out_none(a_out) < 0) {
+            return NULL;
+        }
+        return PyFloat_FromDouble(isocalendar_as_serial(
+            (long)items[0].scalar, (long)items[1].scalar,
+            (long)items[2].scalar));
+    }
+    if (size < -1 || batch_out_init(&out, a_out, size, 'd') < 0) {
+        for (j = 0; j < 3; j++) {
+            batch_arg_release(&items[j]);
+        }
+        return NULL;
+    }
+    for (i = 0; i < size && !failed; i++) {
+        for (j = 0; j < 3; j++) {
+            double v = batch_arg_item(&items[j], i);
+            if (v == -1.0 && PyErr_Occurred()) {
+                failed = 1;
+                break;
+            }
+            if (j == 0) {
+                iso_year = (long)v;
+            }
+            else if (j == 1) {
+                iso_week = (long)v;
+            }
+            else {
+                iso_weekday = (long)v;
+            }
+        }
+        if (!failed) {
+            failed = batch_out_set(&out, i, isocalendar_as_serial(
+                iso_year, iso_week, iso_weekday)) < 0;
+        }
+    }
+    STATS_BATCH(STATS_FROM_ISOCALENDAR, size);
+    for (j = 0; j < 3; j++) {
+        batch_arg_release(&items[j]);
+    }
+    return batch_out_finish(&out, failed);
+}
+
+#define WE_SAT_SUN 1
+#define WE_SUN_MON 2
+#define WE_MON_TUE 3
+#define WE_TUE_WED 4
+#define WE_WED_THU 5
+#define WE_THU_FRI 6
+#define WE_FRI_SAT 7
+#define WE_SUN 11
+#define WE_MON 12
+#define WE_TUE 13
+#define WE_WED 14
+#define WE_THU 15
+#define WE_FRI 16
 #define WE_SAT 17
 
 static PyObject *
@@ -637,7 +783,6 @@ add_weekend_types(PyObject *module)
         PyModule_AddIntMacro(module, WE_THU_FRI) < 0 ||
         PyModule_AddIntMacro(module, WE_FRI_SAT) < 0)
     {
-        Py_DECREF(module);
         return NULL;
     }
     if (PyModule_AddIntMacro(module, WE_SUN) < 0 ||
@@ -648,7 +793,6 @@ add_weekend_types(PyObject *module)
         PyModule_AddIntMacro(module, WE_FRI) < 0 ||
         PyModule_AddIntMacro(module, WE_SAT) < 0)
     {
-        Py_DECREF(module);
         return NULL;
     }
     return module;
@@ -682,6 +826,7 @@ xldt_isweekend(PyObject *self, PyObject *args)
     else if (PyUnicode_Check(a_type)) {
         long day;
         Py_ssize_t i = 0, n = PyUnicode_GET_LENGTH(a_type);
+        STATS_SLOW(STATS_ISWEEKEND);
         day = serial_as_weekday(serial, MON_0);
         if (n == 7) {
             long test = 0;
@@ -704,52 +849,1067 @@ xldt_isweekend(PyObject *self, PyObject *args)
     return NULL;
 }
 
+#define MICROSECONDS_IN_DAY 86400000000LL
+
+/*
+** Return a new datetime.date (or datetime.datetime if with_time is true)
+** corresponding to the value. The time of a datetime is rounded to the
+** microsecond, its date is the next one when the time is rounded to
+** midnight.
+*/
+static PyObject *
+value_as_datetime(double value, int with_time)
+{
+    long day, month, year, second = 0, serial;
+    long long microsecond = 0;
+    serial = x_floor(value);
+    if (with_time) {
+        microsecond = (long long)round((value - serial) * MICROSECONDS_IN_DAY);
+        if (microsecond >= MICROSECONDS_IN_DAY) {
+            serial += 1;
+            microsecond -= MICROSECONDS_IN_DAY;
+        }
+        second = (long)(microsecond / 1000000);
+    }
+    serial_to_date(serial, &year, &month, &day);
+    if (year < 1 || year > 9999) {
+        PyErr_Format(PyExc_OverflowError, DATETIME_RANGE_ERRMSG, serial);
+        return NULL;
+    }
+    if (with_time) {
+        return PyDateTime_FromDateAndTime((int)year, (int)month, (int)day,
+            (int)(second / SECONDS_IN_HOUR),
+            (int)(second % SECONDS_IN_HOUR / SECONDS_IN_MINUTE),
+            (int)(second % SECONDS_IN_MINUTE), (int)(microsecond % 1000000));
+    }
+    return PyDate_FromDate((int)year, (int)month, (int)day);
+}
+
+/*
+** Return the datetime.date or datetime.datetime corresponding to the value
+** if it's a number, otherwise a list with the object corresponding to each
+** item of the value, which must be iterable.
+*/
+static PyObject *
+values_as_datetimes(PyObject *values, int with_time)
+{
+    PyObject *iterator, *item, *result;
+    Py_ssize_t i, size;
+    if (PyFloat_Check(values) || PyLong_Check(values)) {
+        double v = PyFloat_AsDouble(values);
+        if (v == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return value_as_datetime(v, with_time);
+    }
+    if (PyObject_CheckBuffer(values) || PyList_Check(values) ||
+        PyTuple_Check(values))
+    {
+        batch_arg arg;
+        if (batch_arg_init(&arg, values, "value") < 0) {
+            return NULL;
+        }
+        if (arg.kind == BATCH_SCALAR) {
+            return value_as_datetime(arg.scalar, with_time);
+        }
+        result = PyList_New(arg.size);
+        for (i = 0; result != NULL && i < arg.size; i++) {
+            double v = batch_arg_item(&arg, i);
+            if (v == -1.0 && PyErr_Occurred()) {
+                Py_CLEAR(result);
+                break;
+            }
+            item = value_as_datetime(v, with_time);
+            if (item == NULL) {
+                Py_CLEAR(result);
+                break;
+            }
+            PyList_SET_ITEM(result, i, item);
+        }
+        if (result != NULL) {
+            STATS_BATCH(with_time ? STATS_TO_DATETIME : STATS_TO_DATE,
+                        arg.size);
+        }
+        batch_arg_release(&arg);
+        return result;
+    }
+    /*
+    ** The items of other iterables are stored in a list sized with the
+    ** length hint, appended past it and removed if the hint was too big.
+    */
+    iterator = PyObject_GetIter(values);
+    if (iterator == NULL) {
+        return NULL;
+    }
+    size = PyObject_LengthHint(values, 0);
+    result = size < 0 ? NULL : PyList_New(size);
+    i = 0;
+    while (result != NULL && (item = PyIter_Next(iterator)) != NULL) {
+        double v = PyFloat_AsDouble(item);
+        Py_DECREF(item);
+        if (v == -1.0 && PyErr_Occurred()) {
+            Py_CLEAR(result);
+            break;
+        }
+        item = value_as_datetime(v, with_time);
+        if (item == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        if (i < size) {
+            PyList_SET_ITEM(result, i, item);
+        }
+        else if (PyList_Append(result, item) < 0) {
+            Py_DECREF(item);
+            Py_CLEAR(result);
+            break;
+        }
+        else {
+            Py_DECREF(item);
+        }
+        i += 1;
+    }
+    Py_DECREF(iterator);
+    if (result != NULL && PyErr_Occurred()) {
+        Py_CLEAR(result);
+    }
+    if (result != NULL && i < size &&
+        PyList_SetSlice(result, i, size, NULL) < 0)
+    {
+        Py_CLEAR(result);
+    }
+    if (result != NULL) {
+        STATS_BATCH(with_time ? STATS_TO_DATETIME : STATS_TO_DATE, i);
+    }
+    return result;
+}
+
+static PyObject *
+xldt_to_date(PyObject *self, PyObject *args)
+{
+    PyObject *a_value;
+    if (!PyArg_ParseTuple(args, "O", &a_value)) {
+        return NULL;
+    }
+    return values_as_datetimes(a_value, 0);
+}
+
+static PyObject *
+xldt_to_datetime(PyObject *self, PyObject *args)
+{
+    PyObject *a_value;
+    if (!PyArg_ParseTuple(args, "O", &a_value)) {
+        return NULL;
+    }
+    return values_as_datetimes(a_value, 1);
+}
+
+/*
+** Return the value corresponding to the datetime.date or datetime.datetime
+** object. An aware datetime is converted to UTC with its utcoffset(). Return
+** -1.0 with an exception set if the object isn't a date.
+*/
+static double
+datetime_as_value(PyObject *object)
+{
+    long serial;
+    long long microsecond;
+    if (!PyDate_Check(object)) {
+        PyErr_Format(PyExc_TypeError, DATETIME_TYPE_ERRMSG, object);
+        return -1.0;
+    }
+    serial = date_as_serial(PyDateTime_GET_YEAR(object),
+                            PyDateTime_GET_MONTH(object),
+                            PyDateTime_GET_DAY(object));
+    if (!PyDateTime_Check(object)) {
+        return (double)serial;
+    }
+    microsecond = (PyDateTime_DATE_GET_HOUR(object) * SECONDS_IN_HOUR +
+                   PyDateTime_DATE_GET_MINUTE(object) * SECONDS_IN_MINUTE +
+                   PyDateTime_DATE_GET_SECOND(object)) * 1000000LL +
+                  PyDateTime_DATE_GET_MICROSECOND(object);
+    if (((PyDateTime_DateTime *)object)->hastzinfo) {
+        PyObject *offset = PyObject_CallMethod(object, "utcoffset", NULL);
+        if (offset == NULL) {
+            return -1.0;
+        }
+        if (PyDelta_Check(offset)) {
+            microsecond -= (PyDateTime_DELTA_GET_DAYS(offset) *
+                            (long long)SECONDS_IN_DAY +
+                            PyDateTime_DELTA_GET_SECONDS(offset)) * 1000000LL +
+                           PyDateTime_DELTA_GET_MICROSECONDS(offset);
+        }
+        Py_DECREF(offset);
+    }
+    return serial + (double)microsecond / MICROSECONDS_IN_DAY;
+}
+
+static PyObject *
+xldt_from_datetime(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"value", "out", NULL};
+    PyObject *a_value, *a_out = Py_None, *items;
+    batch_out out;
+    Py_ssize_t i, size;
+    int failed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", keywords,
+                                     &a_value, &a_out))
+    {
+        return NULL;
+    }
+    if (PyDate_Check(a_value)) {
+        double value;
+        if (batch_out_none(a_out) < 0) {
+            return NULL;
+        }
+        value = datetime_as_value(a_value);
+        if (value == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyFloat_FromDouble(value);
+    }
+    items = PySequence_Fast(a_value, "from_datetime(): expected a date or "
+                                     "an iterable of dates");
+    if (items == NULL) {
+        return NULL;
+    }
+    size = PySequence_Fast_GET_SIZE(items);
+    if (batch_out_init(&out, a_out, size, 'd') < 0) {
+        Py_DECREF(items);
+        return NULL;
+    }
+    for (i = 0; i < size; i++) {
+        PyObject *item = batch_sequence_item(items, i);
+        double value;
+        if (item == NULL) {
+            failed = 1;
+            break;
+        }
+        value = datetime_as_value(item);
+        Py_DECREF(item);
+        if ((value == -1.0 && PyErr_Occurred()) ||
+            batch_out_set(&out, i, value) < 0)
+        {
+            failed = 1;
+            break;
+        }
+    }
+    STATS_BATCH(STATS_FROM_DATETIME, size);
+    Py_DECREF(items);
+    return batch_out_finish(&out, failed);
+}
+
+/*
+** Split the value in days and ticks of the resolution (if not 0), rounding
+** the ticks and carrying them to the next day like 'value_to_serial' does.
+** Return -1 if the value is not finite or too big.
+*/
+static int
+value_to_ticks(double value, unsigned long resolution, long long *day,
+               long long *tick)
+{
+    double d = floor(value);
+    if (!(d >= -9e18 && d <= 9e18)) {
+        return -1;
+    }
+    *day = (long long)d;
+    *tick = 0;
+    if (resolution != 0) {
+        *tick = (long long)floor((value - d) * resolution + 0.5);
+        if (*tick >= (long long)resolution) {
+            *day += 1;
+            *tick = 0;
+        }
+    }
+    return 0;
+}
+
+/*
+** The initial capacity of the bytes holding the encoded data, doubled
+** whenever it is full.
+*/
+#define CODEC_CAPACITY 4096
+
+/*
+** The destination of the encoded data: a bytes object growing as needed,
+** the writable buffer given as out or the write method of out.
+*/
+typedef struct {
+    PyObject *bytes;
+    PyObject *write;
+    Py_buffer view;
+    int has_view;
+    /* The number of bytes written. */
+    size_t size;
+} codec_writer;
+
+/*
+** Initialize the writer of the out argument of encode(). Return -1 with
+** an exception set on failure.
+*/
+static int
+codec_writer_init(codec_writer *writer, PyObject *out)
+{
+    writer->bytes = NULL;
+    writer->write = NULL;
+    writer->has_view = 0;
+    writer->size = 0;
+    if (out == Py_None) {
+        writer->bytes = PyBytes_FromStringAndSize(NULL, CODEC_CAPACITY);
+        return writer->bytes != NULL ? 0 : -1;
+    }
+    if (PyObject_CheckBuffer(out)) {
+        if (PyObject_GetBuffer(out, &writer->view, PyBUF_WRITABLE) < 0) {
+            return -1;
+        }
+        writer->has_view = 1;
+        return 0;
+    }
+    writer->write = PyObject_GetAttrString(out, "write");
+    if (writer->write == NULL) {
+        PyErr_SetString(PyExc_TypeError, CODEC_OUT_ERRMSG);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** Append the n bytes to the data. Return -1 with an exception set on
+** failure.
+*/
+static int
+codec_writer_put(codec_writer *writer, const unsigned char *p, size_t n)
+{
+    if (writer->write != NULL) {
+        PyObject *result = PyObject_CallFunction(writer->write, "y#",
+                                                 (const char *)p,
+                                                 (Py_ssize_t)n);
+        if (result == NULL) {
+            return -1;
+        }
+        Py_DECREF(result);
+    }
+    else if (writer->has_view) {
+        if (n > (size_t)writer->view.len - writer->size) {
+            PyErr_Format(PyExc_ValueError, CODEC_OUT_SIZE_ERRMSG,
+                         writer->view.len);
+            return -1;
+        }
+        memcpy((char *)writer->view.buf + writer->size, p, n);
+    }
+    else {
+        size_t capacity = (size_t)PyBytes_GET_SIZE(writer->bytes);
+        if (n > capacity - writer->size) {
+            capacity = 2 * capacity > writer->size + n ? 2 * capacity :
+                                                         writer->size + n;
+            if (capacity > (size_t)PY_SSIZE_T_MAX) {
+                PyErr_NoMemory();
+                return -1;
+            }
+            if (_PyBytes_Resize(&writer->bytes, (Py_ssize_t)capacity) < 0) {
+                return -1;
+            }
+        }
+        memcpy(PyBytes_AS_STRING(writer->bytes) + writer->size, p, n);
+    }
+    writer->size += n;
+    return 0;
+}
+
+/*
+** Release the writer and return the result of encode(): the bytes or,
+** when out was given, the number of bytes written. Return NULL if failed
+** is true.
+*/
+static PyObject *
+codec_writer_finish(codec_writer *writer, int failed)
+{
+    if (writer->has_view) {
+        PyBuffer_Release(&writer->view);
+    }
+    Py_XDECREF(writer->write);
+    if (failed) {
+        Py_XDECREF(writer->bytes);
+        return NULL;
+    }
+    if (writer->bytes != NULL) {
+        if (_PyBytes_Resize(&writer->bytes, (Py_ssize_t)writer->size) < 0) {
+            return NULL;
+        }
+        return writer->bytes;
+    }
+    return PyLong_FromSize_t(writer->size);
+}
+
+static PyObject *
+xldt_encode(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"values", "resolution", "block_size", "out",
+                               NULL};
+    PyObject *a_values, *a_out = Py_None;
+    unsigned long long a_resolution = 0, a_block_size = 4096;
+    batch_arg values;
+    codec_header header;
+    codec_writer writer;
+    long long *days = NULL, *ticks = NULL;
+    unsigned char head[CODEC_HEADER_SIZE], *data = NULL, *index = NULL;
+    size_t block, n_blocks, offset;
+    Py_ssize_t i, n;
+    int failed = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|KKO", keywords,
+                                     &a_values, &a_resolution,
+                                     &a_block_size, &a_out))
+    {
+        return NULL;
+    }
+    if (a_resolution > CODEC_MAX_SIZE) {
+        PyErr_Format(PyExc_ValueError, CODEC_RESOLUTION_ERRMSG,
+                     a_resolution);
+        return NULL;
+    }
+    if (a_block_size == 0 || a_block_size > CODEC_MAX_SIZE) {
+        PyErr_Format(PyExc_ValueError, CODEC_BLOCK_SIZE_ERRMSG,
+                     a_block_size);
+        return NULL;
+    }
+    if (batch_arg_init(&values, a_values, "values") < 0) {
+        return NULL;
+    }
+    if (values.kind == BATCH_SCALAR) {
+        PyErr_SetString(PyExc_TypeError, CODEC_VALUES_ERRMSG);
+        return NULL;
+    }
+    if (codec_writer_init(&writer, a_out) < 0) {
+        batch_arg_release(&values);
+        return NULL;
+    }
+    header.flags = a_resolution != 0 ? CODEC_TIME : 0;
+    header.resolution = (unsigned long)a_resolution;
+    header.block_size = (size_t)a_block_size;
+    header.count = (unsigned long long)values.size;
+    n_blocks = codec_blocks(&header);
+    /*
+    ** The data is written block after block, only one block and the index
+    ** are held in memory. The temporary columns are never longer than the
+    ** values.
+    */
+    n = values.size < (Py_ssize_t)a_block_size ? values.size :
+                                                 (Py_ssize_t)a_block_size;
+    days = PyMem_New(long long, n + 1);
+    ticks = PyMem_New(long long, n + 1);
+    data = PyMem_Malloc(codec_block_bound((size_t)n, header.flags));
+    index = PyMem_Malloc(codec_index_size(&header));
+    if (days == NULL || ticks == NULL || data == NULL || index == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    codec_write_header(&header, head);
+    if (codec_writer_put(&writer, head, CODEC_HEADER_SIZE) < 0) {
+        goto done;
+    }
+    offset = CODEC_HEADER_SIZE;
+    for (block = 0; block < n_blocks; block++) {
+        Py_ssize_t first = (Py_ssize_t)(block * header.block_size);
+        size_t size;
+        n = values.size - first < (Py_ssize_t)header.block_size ?
+            values.size - first : (Py_ssize_t)header.block_size;
+        for (i = 0; i < n; i++) {
+            double v = batch_arg_item(&values, first + i);
+            if (v == -1.0 && PyErr_Occurred()) {
+                goto done;
+            }
+            if (value_to_ticks(v, header.resolution, &days[i],
+                               &ticks[i]) < 0)
+            {
+                PyErr_Format(PyExc_ValueError, CODEC_VALUE_ERRMSG,
+                             first + i);
+                goto done;
+            }
+        }
+        codec_write_offset(index, block, offset);
+        size = codec_encode_block(days, header.resolution ? ticks : NULL,
+                                  (size_t)n, data);
+        if (codec_writer_put(&writer, data, size) < 0) {
+            goto done;
+        }
+        offset += size;
+    }
+    codec_write_offset(index, n_blocks, offset);
+    if (codec_writer_put(&writer, index, codec_index_size(&header)) < 0) {
+        goto done;
+    }
+    STATS_BATCH(STATS_ENCODE, values.size);
+    failed = 0;
+done:
+    PyMem_Free(days);
+    PyMem_Free(ticks);
+    PyMem_Free(data);
+    PyMem_Free(index);
+    batch_arg_release(&values);
+    return codec_writer_finish(&writer, failed);
+}
+
+static PyObject *
+xldt_decode(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"data", "start", "stop", "out", NULL};
+    PyObject *a_data, *a_stop = Py_None, *a_out = Py_None;
+    Py_ssize_t a_start = 0, stop, count, n, i, j = 0;
+    Py_buffer view;
+    codec_header header;
+    long long *days = NULL, *ticks = NULL;
+    size_t block;
+    batch_out out;
+    int failed = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nOO", keywords,
+                                     &a_data, &a_start, &a_stop, &a_out))
+    {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(a_data, &view, PyBUF_SIMPLE) < 0) {
+        return NULL;
+    }
+    if (codec_read_header(view.buf, (size_t)view.len, &header) < 0 ||
+        header.count > (unsigned long long)PY_SSIZE_T_MAX)
+    {
+        PyErr_SetString(PyExc_ValueError, CODEC_DATA_ERRMSG);
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    /* The range is adjusted like the bounds of a slice. */
+    count = (Py_ssize_t)header.count;
+    stop = count;
+    if (a_stop != Py_None) {
+        stop = PyNumber_AsSsize_t(a_stop, PyExc_OverflowError);
+        if (stop == -1 && PyErr_Occurred()) {
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+    }
+    if (a_start < 0) {
+        a_start = a_start + count < 0 ? 0 : a_start + count;
+    }
+    if (stop < 0) {
+        stop = stop + count < 0 ? 0 : stop + count;
+    }
+    a_start = a_start > count ? count : a_start;
+    stop = stop > count ? count : stop < a_start ? a_start : stop;
+    if (batch_out_init(&out, a_out, stop - a_start,
+                       header.resolution ? 'd' : 'q') < 0)
+    {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    n = count < (Py_ssize_t)header.block_size ? count :
+                                               (Py_ssize_t)header.block_size;
+    days = PyMem_New(long long, n + 1);
+    ticks = PyMem_New(long long, n + 1);
+    if (days == NULL || ticks == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    /* Only the blocks overlapping the range are decoded. */
+    for (block = (size_t)a_start / header.block_size;
+         j < stop - a_start; block++)
+    {
+        Py_ssize_t first = (Py_ssize_t)(block * header.block_size);
+        size_t start, end;
+        n = count - first < (Py_ssize_t)header.block_size ?
+            count - first : (Py_ssize_t)header.block_size;
+        if (codec_block_range(view.buf, (size_t)view.len, &header, block,
+                              &start, &end) < 0 ||
+            codec_decode_block((const unsigned char *)view.buf + start,
+                               end - start, (size_t)n, days,
+                               header.resolution ? ticks : NULL) < 0)
+        {
+            PyErr_SetString(PyExc_ValueError, CODEC_DATA_ERRMSG);
+            goto done;
+        }
+        for (i = a_start > first ? a_start - first : 0;
+             i < n && first + i < stop; i++, j++)
+        {
+            double v = (double)days[i];
+            if (header.resolution) {
+                v += (double)ticks[i] / header.resolution;
+            }
+            if (batch_out_set(&out, j, v) < 0) {
+                goto done;
+            }
+        }
+    }
+    STATS_BATCH(STATS_DECODE, stop - a_start);
+    failed = 0;
+done:
+    PyMem_Free(days);
+    PyMem_Free(ticks);
+    PyBuffer_Release(&view);
+    return batch_out_finish(&out, failed);
+}
+
+/*
+** The limits of the values and of the multiples of the bucket functions,
+** keeping the ticks and the bucket lengths far from an overflow.
+*/
+#define BUCKET_RANGE 1e9
+#define BUCKET_MAX_MULTIPLE 1000000
+
+/*
+** Return the bucket unit corresponding to the name, in any case.
+** Return 0 with an exception set if the name isn't valid.
+*/
+static long
+bucket_unit(const char *function, PyObject *name)
+{
+    static const char *const names[] = {
+        "second", "minute", "hour", "day", "week", "month", "quarter", "year"
+    };
+    static const long units[] = {
+        BUCKET_SECOND, BUCKET_MINUTE, BUCKET_HOUR, BUCKET_DAY, BUCKET_WEEK,
+        BUCKET_MONTH, BUCKET_QUARTER, BUCKET_YEAR
+    };
+    char lower[8] = {0};
+    const char *text = NULL;
+    size_t i;
+    if (PyUnicode_Check(name)) {
+        text = PyUnicode_AsUTF8(name);
+        if (text == NULL) {
+            return 0;
+        }
+    }
+    if (text != NULL && strlen(text) < sizeof(lower)) {
+        for (i = 0; text[i] != 0; i++) {
+            lower[i] = (char)tolower((unsigned char)text[i]);
+        }
+        for (i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+            if (strcmp(lower, names[i]) == 0) {
+                return units[i];
+            }
+        }
+    }
+    PyErr_Format(PyExc_ValueError, BUCKET_UNIT_ERRMSG, function, name);
+    return 0;
+}
+
+/*
+** Return -1 with an exception set if the value is out of the range of the
+** buckets, 0 otherwise.
+*/
+static int
+bucket_check(const char *function, double value)
+{
+    if (!(value > -BUCKET_RANGE && value < BUCKET_RANGE)) {
+        PyErr_Format(PyExc_ValueError, BUCKET_VALUE_ERRMSG, function);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** The implementation of floor_to, ceil_to and round_to, which apply the
+** given function of the bucket grid to the values.
+*/
+static PyObject *
+bucket_values(PyObject *args, PyObject *kwargs, const char *function,
+              double (*apply)(const bucket_grid *, double),
+              int stats_index)
+{
+    static char *keywords[] = {"value", "unit", "multiple", "origin",
+                               "week_start", "out", NULL};
+    PyObject *a_value, *a_unit, *a_origin = Py_None, *a_out = Py_None;
+    long a_multiple = 1, a_week_start = SUN_1;
+    bucket_grid grid;
+    batch_arg values;
+    batch_out out;
+    Py_ssize_t i;
+    int failed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|lOlO", keywords,
+                                     &a_value, &a_unit, &a_multiple,
+                                     &a_origin, &a_week_start, &a_out))
+    {
+        return NULL;
+    }
+    grid.unit = bucket_unit(function, a_unit);
+    if (grid.unit == 0) {
+        return NULL;
+    }
+    if (a_multiple < 1 || a_multiple > BUCKET_MAX_MULTIPLE) {
+        PyErr_Format(PyExc_ValueError, BUCKET_MULTIPLE_ERRMSG, function,
+                     a_multiple);
+        return NULL;
+    }
+    if (a_week_start != MON_2 && serial_as_weekday(0, a_week_start) < 0) {
+        PyErr_Format(PyExc_ValueError, BUCKET_WEEK_ERRMSG, function,
+                     a_week_start);
+        return NULL;
+    }
+    grid.multiple = a_multiple;
+    grid.week_type = a_week_start;
+    grid.has_origin = a_origin != Py_None;
+    grid.origin = 0;
+    if (grid.has_origin) {
+        double origin = PyFloat_AsDouble(a_origin);
+        if (origin == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (bucket_check(function, origin) < 0) {
+            return NULL;
+        }
+        grid.origin = value_as_ticks(origin);
+    }
+    if (batch_arg_init(&values, a_value, "value") < 0) {
+        return NULL;
+    }
+    if (values.kind == BATCH_SCALAR) {
+        if (batch_out_none(a_out) < 0 ||
+            bucket_check(function, values.scalar) < 0)
+        {
+            return NULL;
+        }
+        return PyFloat_FromDouble(apply(&grid, values.scalar));
+    }
+    if (batch_out_init(&out, a_out, values.size, 'd') < 0) {
+        batch_arg_release(&values);
+        return NULL;
+    }
+    for (i = 0; i < values.size; i++) {
+        double v = batch_arg_item(&values, i);
+        if ((v == -1.0 && PyErr_Occurred()) ||
+            bucket_check(function, v) < 0)
+        {
+            failed = 1;
+            break;
+        }
+        if (batch_out_set(&out, i, apply(&grid, v)) < 0) {
+            failed = 1;
+            break;
+        }
+    }
+    STATS_BATCH(stats_index, values.size);
+    batch_arg_release(&values);
+    return batch_out_finish(&out, failed);
+}
+
+static PyObject *
+xldt_floor_to(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    return bucket_values(args, kwargs, "floor_to", bucket_floor_value,
+                         STATS_FLOOR_TO);
+}
+
+static PyObject *
+xldt_ceil_to(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    return bucket_values(args, kwargs, "ceil_to", bucket_ceil_value,
+                         STATS_CEIL_TO);
+}
+
+static PyObject *
+xldt_round_to(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    return bucket_values(args, kwargs, "round_to", bucket_round_value,
+                         STATS_ROUND_TO);
+}
+
+#ifdef XLDT_STATS
+stats_entry stats_table[STATS_FUNCTIONS];
+
+/*
+** The names of the functions, in the order of the STATS_ values.
+*/
+static const char *const STATS_NAMES[STATS_FUNCTIONS] = {
+    "ceil_to", "date", "datedif", "dates", "day", "days", "decode",
+    "encode", "FiscalCalendar.fiscal", "floor_to", "from_datetime",
+    "from_isocalendar", "hour", "isocalendar", "isweekend", "isoweek",
+    "minute", "month", "months", "now", "round_to", "second", "time",
+    "times", "to_date", "to_datetime", "today", "weekday", "week", "year",
+    "years"
+};
+
+static PyObject *
+stats_histogram(const unsigned long long *buckets)
+{
+    int i;
+    PyObject *list = PyList_New(STATS_BUCKETS);
+    if (list == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < STATS_BUCKETS; i++) {
+        PyObject *count = PyLong_FromUnsignedLongLong(STATS_LOAD(&buckets[i]));
+        if (count == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, count);
+    }
+    return list;
+}
+
+static PyObject *
+stats_entry_as_dict(stats_entry *entry)
+{
+    PyObject *batch_sizes, *latency, *result;
+    batch_sizes = stats_histogram(entry->batch_sizes);
+    latency = stats_histogram(entry->latency);
+    if (batch_sizes == NULL || latency == NULL) {
+        Py_XDECREF(batch_sizes);
+        Py_XDECREF(latency);
+        return NULL;
+    }
+    result = Py_BuildValue("{sKsKsKsKsKsKsKsNsN}",
+                           "calls", STATS_LOAD(&entry->calls),
+                           "converted", STATS_LOAD(&entry->converted),
+                           "slow", STATS_LOAD(&entry->slow),
+                           "errors", STATS_LOAD(&entry->errors),
+                           "rejected", STATS_LOAD(&entry->rejected),
+                           "batches", STATS_LOAD(&entry->batches),
+                           "items", STATS_LOAD(&entry->items),
+                           "batch_sizes", batch_sizes,
+                           "latency", latency);
+    return result;
+}
+#endif
+
+static PyObject *
+xldt_stats(PyObject *self, PyObject *args)
+{
+    PyObject *result = PyDict_New();
+#ifdef XLDT_STATS
+    int i;
+    if (result == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < STATS_FUNCTIONS; i++) {
+        PyObject *entry = stats_entry_as_dict(&stats_table[i]);
+        if (entry == NULL ||
+            PyDict_SetItemString(result, STATS_NAMES[i], entry) < 0)
+        {
+            Py_XDECREF(entry);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(entry);
+    }
+#endif
+    return result;
+}
+
+static PyObject *
+xldt_reset_stats(PyObject *self, PyObject *args)
+{
+#ifdef XLDT_STATS
+    int i, j;
+    for (i = 0; i < STATS_FUNCTIONS; i++) {
+        stats_entry *entry = &stats_table[i];
+        STATS_CLEAR(&entry->calls);
+        STATS_CLEAR(&entry->converted);
+        STATS_CLEAR(&entry->slow);
+        STATS_CLEAR(&entry->errors);
+        STATS_CLEAR(&entry->rejected);
+        STATS_CLEAR(&entry->batches);
+        STATS_CLEAR(&entry->items);
+        for (j = 0; j < STATS_BUCKETS; j++) {
+            STATS_CLEAR(&entry->batch_sizes[j]);
+            STATS_CLEAR(&entry->latency[j]);
+        }
+    }
+#endif
+    Py_RETURN_NONE;
+}
+
+STATS_WRAP_KW(xldt_ceil_to, STATS_CEIL_TO)
+STATS_WRAP(xldt_date, STATS_DATE)
+STATS_WRAP_KW(xldt_datedif, STATS_DATEDIF)
+STATS_WRAP_KW(xldt_dates, STATS_DATES)
+STATS_WRAP(xldt_day, STATS_DAY)
+STATS_WRAP(xldt_days, STATS_DAYS)
+STATS_WRAP_KW(xldt_decode, STATS_DECODE)
+STATS_WRAP_KW(xldt_encode, STATS_ENCODE)
+STATS_WRAP_KW(xldt_floor_to, STATS_FLOOR_TO)
+STATS_WRAP_KW(xldt_from_datetime, STATS_FROM_DATETIME)
+STATS_WRAP_KW(xldt_from_isocalendar, STATS_FROM_ISOCALENDAR)
+STATS_WRAP(xldt_hour, STATS_HOUR)
+STATS_WRAP_KW(xldt_isocalendar, STATS_ISOCALENDAR)
+STATS_WRAP(xldt_isweekend, STATS_ISWEEKEND)
+STATS_WRAP(xldt_isoweek, STATS_ISOWEEK)
+STATS_WRAP(xldt_minute, STATS_MINUTE)
+STATS_WRAP(xldt_month, STATS_MONTH)
+STATS_WRAP(xldt_months, STATS_MONTHS)
+STATS_WRAP(xldt_now, STATS_NOW)
+STATS_WRAP_KW(xldt_round_to, STATS_ROUND_TO)
+STATS_WRAP(xldt_second, STATS_SECOND)
+STATS_WRAP(xldt_time, STATS_TIME)
+STATS_WRAP_KW(xldt_times, STATS_TIMES)
+STATS_WRAP(xldt_to_date, STATS_TO_DATE)
+STATS_WRAP(xldt_to_datetime, STATS_TO_DATETIME)
+STATS_WRAP(xldt_today, STATS_TODAY)
+STATS_WRAP(xldt_weekday, STATS_WEEKDAY)
+STATS_WRAP(xldt_week, STATS_WEEK)
+STATS_WRAP(xldt_year, STATS_YEAR)
+STATS_WRAP(xldt_years, STATS_YEARS)
+
 static PyMethodDef xldt_methods[] = {
-    {"date", xldt_date, METH_VARARGS, xldt_date__doc__},
-    {"day", xldt_day, METH_VARARGS, xldt_day__doc__},
-    {"days", xldt_days, METH_VARARGS, xldt_days__doc__},
-    {"hour", xldt_hour, METH_VARARGS, xldt_hour__doc__},
-    {"isweekend", xldt_isweekend, METH_VARARGS, xldt_isweekend__doc__},
-    {"isoweek", xldt_isoweek, METH_VARARGS, xldt_isoweek__doc__},
-    {"minute", xldt_minute, METH_VARARGS, xldt_minute__doc__},
-    {"month", xldt_month, METH_VARARGS, xldt_month__doc__},
-    {"months", xldt_months, METH_VARARGS, xldt_months__doc__},
-    {"now", xldt_now, METH_NOARGS, xldt_now__doc__},
-    {"second", xldt_second, METH_VARARGS, xldt_second__doc__},
-    {"time", xldt_time, METH_VARARGS, xldt_time__doc__},
-    {"today", xldt_today, METH_NOARGS, xldt_today__doc__},
-    {"weekday", xldt_weekday, METH_VARARGS, xldt_weekday__doc__},
-    {"week", xldt_week, METH_VARARGS, xldt_week__doc__},
-    {"year", xldt_year, METH_VARARGS, xldt_year__doc__},
-    {"years", xldt_years, METH_VARARGS, xldt_years__doc__},
+    {"ceil_to", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_ceil_to),
+     METH_VARARGS | METH_KEYWORDS, xldt_ceil_to__doc__},
+    {"date", STATS_METHOD(xldt_date), METH_VARARGS,
+     xldt_date__doc__},
+    {"datedif", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_datedif),
+     METH_VARARGS | METH_KEYWORDS, xldt_datedif__doc__},
+    {"dates", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_dates),
+     METH_VARARGS | METH_KEYWORDS, xldt_dates__doc__},
+    {"day", STATS_METHOD(xldt_day), METH_VARARGS,
+     xldt_day__doc__},
+    {"days", STATS_METHOD(xldt_days), METH_VARARGS,
+     xldt_days__doc__},
+    {"decode", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_decode),
+     METH_VARARGS | METH_KEYWORDS, xldt_decode__doc__},
+    {"encode", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_encode),
+     METH_VARARGS | METH_KEYWORDS, xldt_encode__doc__},
+    {"floor_to", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_floor_to),
+     METH_VARARGS | METH_KEYWORDS, xldt_floor_to__doc__},
+    {"from_datetime",
+     (PyCFunction)(void (*)(void))STATS_METHOD(xldt_from_datetime),
+     METH_VARARGS | METH_KEYWORDS, xldt_from_datetime__doc__},
+    {"from_isocalendar",
+     (PyCFunction)(void (*)(void))STATS_METHOD(xldt_from_isocalendar),
+     METH_VARARGS | METH_KEYWORDS, xldt_from_isocalendar__doc__},
+    {"hour", STATS_METHOD(xldt_hour), METH_VARARGS,
+     xldt_hour__doc__},
+    {"isocalendar",
+     (PyCFunction)(void (*)(void))STATS_METHOD(xldt_isocalendar),
+     METH_VARARGS | METH_KEYWORDS, xldt_isocalendar__doc__},
+    {"isweekend", STATS_METHOD(xldt_isweekend), METH_VARARGS,
+     xldt_isweekend__doc__},
+    {"isoweek", STATS_METHOD(xldt_isoweek), METH_VARARGS,
+     xldt_isoweek__doc__},
+    {"minute", STATS_METHOD(xldt_minute), METH_VARARGS,
+     xldt_minute__doc__},
+    {"month", STATS_METHOD(xldt_month), METH_VARARGS,
+     xldt_month__doc__},
+    {"months", STATS_METHOD(xldt_months), METH_VARARGS,
+     xldt_months__doc__},
+    {"now", STATS_METHOD(xldt_now), METH_NOARGS,
+     xldt_now__doc__},
+    {"reset_stats", xldt_reset_stats, METH_NOARGS, xldt_reset_stats__doc__},
+    {"round_to", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_round_to),
+     METH_VARARGS | METH_KEYWORDS, xldt_round_to__doc__},
+    {"second", STATS_METHOD(xldt_second), METH_VARARGS,
+     xldt_second__doc__},
+    {"stats", xldt_stats, METH_NOARGS, xldt_stats__doc__},
+    {"time", STATS_METHOD(xldt_time), METH_VARARGS,
+     xldt_time__doc__},
+    {"times", (PyCFunction)(void (*)(void))STATS_METHOD(xldt_times),
+     METH_VARARGS | METH_KEYWORDS, xldt_times__doc__},
+    {"to_date", STATS_METHOD(xldt_to_date), METH_VARARGS,
+     xldt_to_date__doc__},
+    {"to_datetime", STATS_METHOD(xldt_to_datetime), METH_VARARGS,
+     xldt_to_datetime__doc__},
+    {"today", STATS_METHOD(xldt_today), METH_NOARGS,
+     xldt_today__doc__},
+    {"weekday", STATS_METHOD(xldt_weekday), METH_VARARGS,
+     xldt_weekday__doc__},
+    {"week", STATS_METHOD(xldt_week), METH_VARARGS,
+     xldt_week__doc__},
+    {"year", STATS_METHOD(xldt_year), METH_VARARGS,
+     xldt_year__doc__},
+    {"years", STATS_METHOD(xldt_years), METH_VARARGS,
+     xldt_years__doc__},
     {NULL, NULL, 0, NULL}
 };
 
+static const XLDT_CAPI xldt_capi = {
+    XLDT_CAPI_VERSION,
+    serial_to_date,
+    date_as_serial,
+    serial_as_weekday,
+    serial_as_week,
+    serial_to_fields,
+    fields_difference,
+    fields_as_isoweek,
+    isocalendar_as_serial,
+    serials_to_fields,
+    dates_as_serials,
+    fields_differences
+};
+
+static PyObject *
+add_capi(PyObject *module)
+{
+    PyObject *capsule;
+    if (module == NULL) {
+        return NULL;
+    }
+    capsule = PyCapsule_New((void *)&xldt_capi, XLDT_CAPSULE_NAME, NULL);
+    if (capsule == NULL || PyModule_AddObject(module, "_C_API", capsule) < 0)
+    {
+        Py_XDECREF(capsule);
+        return NULL;
+    }
+    return module;
+}
+
 static int
 xldt_exec(PyObject *module)
 {
+    PyDateTime_IMPORT;
+    if (PyDateTimeAPI == NULL) {
+        return -1;
+    }
     if (add_week_types(module) == NULL || add_weekend_types(module) == NULL) 
     {
         return -1;
     }
+    if (add_capi(module) == NULL) {
+        return -1;
+    }
+    if (PyType_Ready(&SerialArray_Type) < 0) {
+        return -1;
+    }
+    Py_INCREF(&SerialArray_Type);
+    if (PyModule_AddObject(module, "SerialArray",
+                           (PyObject *)&SerialArray_Type) < 0)
+    {
+        Py_DECREF(&SerialArray_Type);
+        return -1;
+    }
+    if (PyType_Ready(&FiscalCalendar_Type) < 0) {
+        return -1;
+    }
+    Py_INCREF(&FiscalCalendar_Type);
+    if (PyModule_AddObject(module, "FiscalCalendar",
+                           (PyObject *)&FiscalCalendar_Type) < 0)
+    {
+        Py_DECREF(&FiscalCalendar_Type);
+        return -1;
+    }
     return 0;
 }
 
+/*
+** The module can run without the GIL on the free-threaded builds of
+** CPython (3.13 and later): the tables are constant, the counters of the
+** stats (when compiled) are updated with atomic operations, and the lazy
+** fields of SerialArray and the cached years of FiscalCalendar are guarded
+** by the critical section of their object. The other functions work on
+** their arguments and local variables only.
+*/
 static PyModuleDef_Slot xldt_slots[] = {
     {Py_mod_exec, xldt_exec},
+#ifdef Py_mod_gil
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
     {0, NULL}
 };
 
 static PyModuleDef xldt_module = {
-    PyModuleDef_HEAD_INIT
+    PyModuleDef_HEAD_INIT,
+    "xldt",
+    xldt__doc__,
+    0,
+    xldt_methods,
+    xldt_slots
 };
 
 PyMODINIT_FUNC 
 PyInit_xldt(void) {
-    xldt_module.m_name = "xldt";
-    xldt_module.m_doc = xldt__doc__;
-    xldt_module.m_size = 0;
-    xldt_module.m_methods = xldt_methods;
-    xldt_module.m_slots = xldt_slots;
     return PyModuleDef_Init(&xldt_module);
 }
@@ -0,0 +1,222 @@
+#ifndef __XLDT_H__
+#define __XLDT_H__
+
+#include <stddef.h>
+
+/*
+** The public interface of libxldt_core, the calendar core and the codec
+** of the module built as a static library for native programs which don't
+** use Python (see the Makefile). It only declares names starting with
+** XLDT_ or xldt_, the library only exports symbols starting with xldt_,
+** so that they don't collide with those of the programs linking it. It
+** can be included from C or C++.
+*/
+
+/*
+** The week types of 'xldt_serial_as_weekday' and 'xldt_serial_as_week',
+** the values of the constants of the module with the same names.
+*/
+#define XLDT_SUN_1 1
+#define XLDT_MON_1 2
+#define XLDT_MON_0 3
+#define XLDT_MON_1_EXT 11
+#define XLDT_TUE_1_EXT 12
+#define XLDT_WED_1_EXT 13
+#define XLDT_THU_1_EXT 14
+#define XLDT_FRI_1_EXT 15
+#define XLDT_SAT_1_EXT 16
+#define XLDT_SUN_1_EXT 17
+#define XLDT_MON_2 21
+
+/*
+** The units of 'xldt_fields_difference', with the meaning of the unit
+** argument of Excel's DATEDIF function.
+*/
+#define XLDT_DIF_D  1
+#define XLDT_DIF_M  2
+#define XLDT_DIF_Y  3
+#define XLDT_DIF_MD 4
+#define XLDT_DIF_YM 5
+#define XLDT_DIF_YD 6
+
+/*
+** A serial number with the year, month and day of its date.
+*/
+struct xldt_date_fields {
+    long serial;
+    long year;
+    long month;
+    long day;
+};
+
+/*
+** The patterns of the fiscal calendars. XLDT_FISCAL_MONTHS divides the
+** fiscal year in calendar months, the other ones divide a 52 or 53 week
+** fiscal year in periods of 4 or 5 weeks, repeated for every quarter.
+*/
+#define XLDT_FISCAL_MONTHS 0
+#define XLDT_FISCAL_445    1
+#define XLDT_FISCAL_454    2
+#define XLDT_FISCAL_544    3
+
+/*
+** A fiscal calendar. The fiscal year starts with the start_month (1 - 12)
+** and is numbered with the calendar year in which it ends. For the week
+** patterns, the fiscal year ends on the weekday (1 for Monday to 7 for
+** Sunday, like XLDT_MON_1) which is the last one of the month before the
+** start_month or, if nearest is true, the nearest to its end.
+*/
+typedef struct xldt_fiscal_calendar {
+    long start_month;
+    long pattern;
+    long weekday;
+    long nearest;
+} xldt_fiscal_calendar;
+
+/*
+** The first days of the 12 periods of a fiscal year, followed by the first
+** day of the next fiscal year.
+*/
+#define XLDT_FISCAL_PERIODS 12
+
+typedef struct xldt_fiscal_year {
+    long year;
+    long starts[XLDT_FISCAL_PERIODS + 1];
+} xldt_fiscal_year;
+
+/*
+** The units of the buckets of 'xldt_bucket_floor'. The buckets of the
+** units up to XLDT_BUCKET_DAY have a fixed length, the other ones follow
+** the calendar.
+*/
+#define XLDT_BUCKET_SECOND  1
+#define XLDT_BUCKET_MINUTE  2
+#define XLDT_BUCKET_HOUR    3
+#define XLDT_BUCKET_DAY     4
+#define XLDT_BUCKET_WEEK    5
+#define XLDT_BUCKET_MONTH   6
+#define XLDT_BUCKET_QUARTER 7
+#define XLDT_BUCKET_YEAR    8
+
+/*
+** The bucketing works on times counted in milliseconds (ticks) from the
+** midnight starting the serial 0, so that the bucket bounds are exact.
+*/
+#define XLDT_TICKS_IN_DAY 86400000LL
+
+/*
+** A grid of buckets of multiple units. The buckets are aligned on the
+** origin (in ticks) if has_origin is true, otherwise on the serial 0 for
+** the fixed units, on a week start for the weeks and on the 1st January
+** of the year 0 for the calendar units. The weeks start on the day which
+** is the first one for the week type (a value of 'xldt_serial_as_week'),
+** the calendar units on the first day of a month. For the weeks and the
+** calendar units the origin only selects the week or the month starting
+** a bucket.
+*/
+typedef struct xldt_bucket_grid {
+    long unit;
+    long multiple;
+    long week_type;
+    int has_origin;
+    long long origin;
+} xldt_bucket_grid;
+
+/*
+** A compact binary format for columns of serial numbers.
+**
+** The encoded data starts with a header of XLDT_CODEC_HEADER_SIZE bytes
+** (all the integers are little endian):
+**   0  "XLDT"
+**   4  the version (1 byte), XLDT_CODEC_VERSION
+**   5  the flags (1 byte), XLDT_CODEC_TIME if there is a time stream
+**   6  0 (2 bytes)
+**   8  the resolution (4 bytes), the time ticks per day, 0 without time
+**   12 the block size (4 bytes), the number of serials per block
+**   16 the number of serials (8 bytes)
+** It is followed by the blocks, then by the index: the offsets (8 bytes
+** each) of the blocks from the start of the data, with one more offset
+** for the end of the last block, so that any block can be decoded alone.
+** The index is the last 8 * (blocks + 1) bytes of the data, which can so
+** be written in one pass, block after block, but must be read with its
+** exact size.
+** A block stores the days of its serials as the first day and the deltas
+** between consecutive days, packed with a frame of reference (the
+** minimum delta, followed by the differences on the minimum number of
+** bits). Sorted days with one serial per day have equal deltas and take
+** no bits at all.
+** The time stream, if any, stores the time of the day in ticks, packed
+** with a frame of reference too.
+*/
+#define XLDT_CODEC_HEADER_SIZE 24
+#define XLDT_CODEC_VERSION 1
+#define XLDT_CODEC_TIME 1
+/* The largest resolution and block size, stored on 4 bytes. */
+#define XLDT_CODEC_MAX_SIZE 0xffffffffUL
+
+typedef struct xldt_codec_header {
+    unsigned int flags;
+    unsigned long resolution;
+    size_t block_size;
+    unsigned long long count;
+} xldt_codec_header;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void xldt_serial_to_date(long serial, long *year, long *month, long *day);
+long xldt_date_as_serial(long year, long month, long day);
+long xldt_serial_as_weekday(long serial, long type);
+long xldt_serial_as_week(long serial, long type);
+void xldt_value_to_serial(double value, long *serial, long *second);
+void xldt_serial_to_fields(long serial, struct xldt_date_fields *date);
+long xldt_fields_difference(const struct xldt_date_fields *start,
+                            const struct xldt_date_fields *end, long unit);
+long xldt_fields_as_isoweek(const struct xldt_date_fields *date,
+                            long *iso_year);
+long xldt_isocalendar_as_serial(long iso_year, long iso_week,
+                                long iso_weekday);
+void xldt_serials_to_fields(const long *serials, size_t n,
+                            struct xldt_date_fields *dates);
+void xldt_dates_as_serials(const long *years, const long *months,
+                           const long *days, size_t n, long *serials);
+void xldt_fields_differences(const struct xldt_date_fields *starts,
+                             const struct xldt_date_fields *ends, size_t n,
+                             long unit, long *results);
+void xldt_fiscal_year_bounds(const xldt_fiscal_calendar *calendar,
+                             long year, xldt_fiscal_year *bounds);
+long xldt_serial_to_fiscal(const xldt_fiscal_calendar *calendar,
+                           long serial, xldt_fiscal_year *bounds,
+                           long *quarter, long *period, long *week);
+long long xldt_value_as_ticks(double value);
+double xldt_ticks_as_value(long long ticks);
+long long xldt_bucket_floor(const xldt_bucket_grid *grid, long long ticks);
+long long xldt_bucket_next(const xldt_bucket_grid *grid, long long start);
+long long xldt_bucket_ceil(const xldt_bucket_grid *grid, long long ticks);
+double xldt_bucket_floor_value(const xldt_bucket_grid *grid, double value);
+double xldt_bucket_ceil_value(const xldt_bucket_grid *grid, double value);
+double xldt_bucket_round_value(const xldt_bucket_grid *grid, double value);
+
+size_t xldt_codec_blocks(const xldt_codec_header *header);
+size_t xldt_codec_index_size(const xldt_codec_header *header);
+size_t xldt_codec_block_bound(size_t n, unsigned int flags);
+void xldt_codec_write_header(const xldt_codec_header *header,
+                             unsigned char *data);
+int xldt_codec_read_header(const unsigned char *data, size_t size,
+                           xldt_codec_header *header);
+void xldt_codec_write_offset(unsigned char *index, size_t block,
+                             unsigned long long offset);
+int xldt_codec_block_range(const unsigned char *data, size_t size,
+                           const xldt_codec_header *header, size_t block,
+                           size_t *start, size_t *end);
+size_t xldt_codec_encode_block(const long long *days, const long long *ticks,
+                               size_t n, unsigned char *out);
+int xldt_codec_decode_block(const unsigned char *data, size_t size,
+                            size_t n, long long *days, long long *ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
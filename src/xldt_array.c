@@ -0,0 +1,412 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <limits.h>
+
+#include "xldt_array.h"
+#include "xldt_core.h"
+#include "xldt_msg.h"
+
+/*
+** The critical sections protect the lazy computation of the fields when
+** the module runs without the GIL. They don't exist before Python 3.13.
+*/
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+/*
+** The date fields are stored in one bytes object, one array after the
+** other: the years on 16 bits, then the months, the days, the weekdays
+** (SUN_1) and the ISO week numbers on 8 bits. Each field of a serial
+** takes FIELDS_SIZE bytes.
+*/
+#define FIELDS_SIZE 6
+
+typedef struct {
+    PyObject_HEAD
+    /* The array owning the buffer and the fields, NULL if it's this one. */
+    PyObject *base;
+    /* The buffer of the serial numbers, only held by the base. */
+    Py_buffer view;
+    /* The format of the serial numbers, 'i' or 'd', and their size. */
+    char format[2];
+    Py_ssize_t itemsize;
+    /* The first serial number of the array and the number of serials. */
+    const char *data;
+    Py_ssize_t size;
+    /* The index of the first serial in the buffer of the base. */
+    Py_ssize_t offset;
+    /* The fields of the base, NULL until they are computed. */
+    PyObject *fields;
+} SerialArrayObject;
+
+#define BASE_OF(a) \
+    ((SerialArrayObject *)((a)->base != NULL ? (a)->base : (PyObject *)(a)))
+
+static PyObject *
+SerialArray_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"values", NULL};
+    PyObject *a_values;
+    SerialArrayObject *self;
+    const char *format;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", keywords,
+                                     &a_values))
+    {
+        return NULL;
+    }
+    self = (SerialArrayObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(a_values, &self->view,
+                           PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+    {
+        Py_DECREF(self);
+        return NULL;
+    }
+    format = self->view.format != NULL ? self->view.format : "B";
+    if (format[0] == '@') {
+        format += 1;
+    }
+    if (self->view.ndim == 1 && (strcmp(format, "d") == 0 ||
+        ((strcmp(format, "i") == 0 || strcmp(format, "l") == 0) &&
+         self->view.itemsize == 4)))
+    {
+        self->format[0] = format[0] == 'd' ? 'd' : 'i';
+    }
+    else {
+        PyErr_SetString(PyExc_TypeError, SERIAL_ARRAY_FORMAT_ERRMSG);
+        Py_DECREF(self);
+        return NULL;
+    }
+    self->itemsize = self->view.itemsize;
+    self->data = self->view.buf;
+    self->size = self->view.len / self->itemsize;
+    return (PyObject *)self;
+}
+
+static void
+SerialArray_dealloc(SerialArrayObject *self)
+{
+    if (self->view.obj != NULL) {
+        PyBuffer_Release(&self->view);
+    }
+    Py_XDECREF(self->base);
+    Py_XDECREF(self->fields);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+** Return the serial number at the index i of the array.
+*/
+static long
+serial_at(const SerialArrayObject *self, Py_ssize_t i)
+{
+    if (self->format[0] == 'd') {
+        return x_floor(((const double *)self->data)[i]);
+    }
+    return ((const int *)self->data)[i];
+}
+
+/*
+** Compute the fields of all the serials of the base in one pass.
+** Return NULL with an exception set on failure.
+*/
+static PyObject *
+compute_fields(SerialArrayObject *base)
+{
+    PyObject *fields;
+    short *year;
+    signed char *month, *day, *weekday, *isoweek;
+    Py_ssize_t i, n = base->size;
+    date_fields date;
+    long iso_year;
+    fields = PyBytes_FromStringAndSize(NULL, n * FIELDS_SIZE);
+    if (fields == NULL) {
+        return NULL;
+    }
+    year = (short *)PyBytes_AS_STRING(fields);
+    month = (signed char *)(year + n);
+    day = month + n;
+    weekday = day + n;
+    isoweek = weekday + n;
+    for (i = 0; i < n; i++) {
+        serial_to_fields(serial_at(base, i), &date);
+        if (date.year < SHRT_MIN || date.year > SHRT_MAX) {
+            PyErr_Format(PyExc_OverflowError, SERIAL_ARRAY_RANGE_ERRMSG,
+                         date.serial);
+            Py_DECREF(fields);
+            return NULL;
+        }
+        year[i] = (short)date.year;
+        month[i] = (signed char)date.month;
+        day[i] = (signed char)date.day;
+        weekday[i] = (signed char)serial_as_weekday(date.serial, SUN_1);
+        isoweek[i] = (signed char)fields_as_isoweek(&date, &iso_year);
+    }
+    return fields;
+}
+
+/*
+** Return a memoryview of the field starting at the given offset (in
+** bytes) of the fields of the base, restricted to the serials of the
+** array. The fields are computed on the first call.
+*/
+static PyObject *
+get_field(SerialArrayObject *self, Py_ssize_t offset, Py_ssize_t itemsize,
+          const char *format)
+{
+    SerialArrayObject *base = BASE_OF(self);
+    PyObject *fields, *view, *part, *result;
+    Py_ssize_t start;
+    Py_BEGIN_CRITICAL_SECTION(base);
+    if (base->fields == NULL) {
+        base->fields = compute_fields(base);
+    }
+    fields = base->fields;
+    Py_XINCREF(fields);
+    Py_END_CRITICAL_SECTION();
+    if (fields == NULL) {
+        return NULL;
+    }
+    view = PyMemoryView_FromObject(fields);
+    Py_DECREF(fields);
+    if (view == NULL) {
+        return NULL;
+    }
+    start = offset * base->size + self->offset * itemsize;
+    part = PySequence_GetSlice(view, start, start + self->size * itemsize);
+    Py_DECREF(view);
+    if (part == NULL) {
+        return NULL;
+    }
+    result = PyObject_CallMethod(part, "cast", "s", format);
+    Py_DECREF(part);
+    return result;
+}
+
+static PyObject *
+SerialArray_year(SerialArrayObject *self, void *closure)
+{
+    return get_field(self, 0, 2, "h");
+}
+
+static PyObject *
+SerialArray_month(SerialArrayObject *self, void *closure)
+{
+    return get_field(self, 2, 1, "b");
+}
+
+static PyObject *
+SerialArray_day(SerialArrayObject *self, void *closure)
+{
+    return get_field(self, 3, 1, "b");
+}
+
+static PyObject *
+SerialArray_weekday(SerialArrayObject *self, void *closure)
+{
+    return get_field(self, 4, 1, "b");
+}
+
+static PyObject *
+SerialArray_isoweek(SerialArrayObject *self, void *closure)
+{
+    return get_field(self, 5, 1, "b");
+}
+
+static Py_ssize_t
+SerialArray_length(SerialArrayObject *self)
+{
+    return self->size;
+}
+
+static PyObject *
+SerialArray_item(SerialArrayObject *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= self->size) {
+        PyErr_SetString(PyExc_IndexError, SERIAL_ARRAY_INDEX_ERRMSG);
+        return NULL;
+    }
+    if (self->format[0] == 'd') {
+        return PyFloat_FromDouble(((const double *)self->data)[i]);
+    }
+    return PyLong_FromLong(((const int *)self->data)[i]);
+}
+
+/*
+** Return the slice [start, stop) of the array, sharing its serials and its
+** fields.
+*/
+static PyObject *
+SerialArray_slice(SerialArrayObject *self, Py_ssize_t start,
+                  Py_ssize_t stop)
+{
+    SerialArrayObject *base = BASE_OF(self), *result;
+    result = (SerialArrayObject *)
+        Py_TYPE(self)->tp_alloc(Py_TYPE(self), 0);
+    if (result == NULL) {
+        return NULL;
+    }
+    Py_INCREF(base);
+    result->base = (PyObject *)base;
+    result->format[0] = self->format[0];
+    result->itemsize = self->itemsize;
+    result->data = self->data + start * self->itemsize;
+    result->size = stop > start ? stop - start : 0;
+    result->offset = self->offset + start;
+    return (PyObject *)result;
+}
+
+static PyObject *
+SerialArray_subscript(SerialArrayObject *self, PyObject *key)
+{
+    if (PyIndex_Check(key)) {
+        Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if (i == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (i < 0) {
+            i += self->size;
+        }
+        return SerialArray_item(self, i);
+    }
+    if (PySlice_Check(key)) {
+        Py_ssize_t start, stop, step, length;
+        if (PySlice_GetIndicesEx(key, self->size, &start, &stop, &step,
+                                 &length) < 0)
+        {
+            return NULL;
+        }
+        if (step != 1) {
+            PyErr_SetString(PyExc_ValueError, SERIAL_ARRAY_STEP_ERRMSG);
+            return NULL;
+        }
+        return SerialArray_slice(self, start, start + length);
+    }
+    PyErr_Format(PyExc_TypeError, SERIAL_ARRAY_KEY_ERRMSG, key);
+    return NULL;
+}
+
+/*
+** Export the serial numbers as a read-only buffer.
+*/
+static int
+SerialArray_getbuffer(SerialArrayObject *self, Py_buffer *view, int flags)
+{
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, SERIAL_ARRAY_WRITE_ERRMSG);
+        view->obj = NULL;
+        return -1;
+    }
+    view->buf = (void *)self->data;
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->len = self->size * self->itemsize;
+    view->readonly = 1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? self->format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &self->size : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ?
+                    &self->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyObject *
+SerialArray_repr(SerialArrayObject *self)
+{
+    return PyUnicode_FromFormat("SerialArray(size=%zd, format='%s')",
+                                self->size, self->format);
+}
+
+static PyGetSetDef SerialArray_getset[] = {
+    {"year", (getter)SerialArray_year, NULL,
+     "The years of the dates (16 bit integers).", NULL},
+    {"month", (getter)SerialArray_month, NULL,
+     "The months (1 - 12) of the dates (8 bit integers).", NULL},
+    {"day", (getter)SerialArray_day, NULL,
+     "The days (1 - 31) of the dates (8 bit integers).", NULL},
+    {"weekday", (getter)SerialArray_weekday, NULL,
+     "The weekdays of the dates like weekday(value, SUN_1) (8 bit\n"
+     "integers).", NULL},
+    {"isoweek", (getter)SerialArray_isoweek, NULL,
+     "The ISO week numbers of the dates (8 bit integers).", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyMappingMethods SerialArray_as_mapping = {
+    (lenfunc)SerialArray_length,
+    (binaryfunc)SerialArray_subscript,
+    NULL
+};
+
+static PySequenceMethods SerialArray_as_sequence = {
+    (lenfunc)SerialArray_length,
+    0,
+    0,
+    (ssizeargfunc)SerialArray_item
+};
+
+static PyBufferProcs SerialArray_as_buffer = {
+    (getbufferproc)SerialArray_getbuffer,
+    NULL
+};
+
+PyDoc_STRVAR(SerialArray__doc__,
+"SerialArray(values)\n\n\
+A column of serial numbers wrapping the buffer of values, which must be\n\
+a one-dimensional buffer of 32 bit integers or of floats (like an\n\
+array.array('i') or a numpy array of int32 or float64), without copying\n\
+it. The year, month, day, weekday and isoweek attributes are\n\
+memoryviews of the date fields of the serials, all computed in one pass\n\
+on the first access and shared with the slices of the array. A slice\n\
+(with step 1) is a SerialArray using the same buffer and fields.\n\
+The values must not be modified once wrapped, the fields computed\n\
+before wouldn't be updated. The array exports its serial numbers as a\n\
+read-only buffer.");
+
+PyTypeObject SerialArray_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "xldt.SerialArray",                 /* tp_name */
+    sizeof(SerialArrayObject),          /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor)SerialArray_dealloc,    /* tp_dealloc */
+    0,                                  /* tp_vectorcall_offset */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_as_async */
+    (reprfunc)SerialArray_repr,         /* tp_repr */
+    0,                                  /* tp_as_number */
+    &SerialArray_as_sequence,           /* tp_as_sequence */
+    &SerialArray_as_mapping,            /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    &SerialArray_as_buffer,             /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    SerialArray__doc__,                 /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    0,                                  /* tp_iter */
+    0,                                  /* tp_iternext */
+    0,                                  /* tp_methods */
+    0,                                  /* tp_members */
+    SerialArray_getset,                 /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    SerialArray_new,                    /* tp_new */
+};
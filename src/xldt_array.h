@@ -0,0 +1,14 @@
+#ifndef __XLDT_ARRAY_H__
+#define __XLDT_ARRAY_H__
+
+#ifndef Py_PYTHON_H
+#error The Python header must be included before this header.
+#endif
+
+/*
+** The SerialArray type, a column of serial numbers with its date fields
+** computed once, on first access.
+*/
+extern PyTypeObject SerialArray_Type;
+
+#endif
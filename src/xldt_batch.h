@@ -0,0 +1,539 @@
+#ifndef __XLDT_BATCH_H__
+#define __XLDT_BATCH_H__
+
+#ifndef Py_PYTHON_H
+#error The Python header must be included before this header.
+#endif
+
+#include <float.h>
+#include <limits.h>
+
+#include "xldt_msg.h"
+
+/*
+** Helpers for the batch functions. An input argument can be a number,
+** which is broadcast to the length of the other arguments, an object
+** exporting a one-dimensional contiguous buffer of integers or floats
+** (like array.array or a numpy array), or any other sequence of numbers.
+** An output is written either in a writable buffer given by the caller
+** or in a new buffer returned as a memoryview.
+** The helpers are inline, so that each file uses only the ones it needs.
+*/
+
+/*
+** The items of a list argument are read in a critical section, so that
+** another thread can't free them while the module runs without the GIL.
+** The critical sections don't exist before Python 3.13.
+*/
+#if defined(Py_BEGIN_CRITICAL_SECTION_SEQUENCE_FAST)
+#define BATCH_BEGIN_SEQUENCE(op) Py_BEGIN_CRITICAL_SECTION_SEQUENCE_FAST(op)
+#define BATCH_END_SEQUENCE() Py_END_CRITICAL_SECTION_SEQUENCE_FAST()
+#elif defined(Py_BEGIN_CRITICAL_SECTION)
+#define BATCH_BEGIN_SEQUENCE(op) Py_BEGIN_CRITICAL_SECTION(op)
+#define BATCH_END_SEQUENCE() Py_END_CRITICAL_SECTION()
+#else
+#define BATCH_BEGIN_SEQUENCE(op) {
+#define BATCH_END_SEQUENCE() }
+#endif
+
+/*
+** True if the value converted to an integer type (truncated) is between
+** the limits of the type.
+*/
+#define BATCH_FITS(v, low, high) \
+    ((v) > (double)(low) - 1.0 && (v) < (double)(high) + 1.0)
+
+#define BATCH_SCALAR   0
+#define BATCH_BUFFER   1
+#define BATCH_SEQUENCE 2
+
+typedef struct {
+    int kind;
+    /* The value of a scalar argument. */
+    double scalar;
+    /* The buffer of a buffer argument, its item format and size. */
+    Py_buffer view;
+    char format;
+    /* The items of a sequence argument. */
+    PyObject *items;
+    /* The number of items, -1 for a scalar argument. */
+    Py_ssize_t size;
+} batch_arg;
+
+typedef struct {
+    Py_buffer view;
+    char format;
+    /* The object returned to the caller. */
+    PyObject *result;
+} batch_out;
+
+/*
+** Return the item format of the buffer if it's a native numeric format
+** supported by the batch functions, 0 otherwise.
+*/
+Py_LOCAL_INLINE(char)
+batch_format(const Py_buffer *view)
+{
+    const char *format = view->format;
+    if (format == NULL) {
+        return 'B';
+    }
+    if (format[0] == '@') {
+        format += 1;
+    }
+    if (format[0] != 0 && format[1] == 0 &&
+        strchr("bBhHiIlLqQfd", format[0]) != NULL)
+    {
+        return format[0];
+    }
+    return 0;
+}
+
+/*
+** Return the item i of a buffer argument.
+*/
+Py_LOCAL_INLINE(double)
+batch_buffer_item(const Py_buffer *view, char format, Py_ssize_t i)
+{
+    const void *p = view->buf;
+    switch (format) {
+    case 'b': return ((const signed char *)p)[i];
+    case 'B': return ((const unsigned char *)p)[i];
+    case 'h': return ((const short *)p)[i];
+    case 'H': return ((const unsigned short *)p)[i];
+    case 'i': return ((const int *)p)[i];
+    case 'I': return ((const unsigned int *)p)[i];
+    case 'l': return (double)((const long *)p)[i];
+    case 'L': return (double)((const unsigned long *)p)[i];
+    case 'q': return (double)((const long long *)p)[i];
+    case 'Q': return (double)((const unsigned long long *)p)[i];
+    case 'f': return ((const float *)p)[i];
+    }
+    return ((const double *)p)[i];
+}
+
+/*
+** Initialize the argument from the object. Return -1 with an exception
+** set if the object isn't a number, a supported buffer or a sequence.
+*/
+Py_LOCAL_INLINE(int)
+batch_arg_init(batch_arg *arg, PyObject *object, const char *name)
+{
+    arg->kind = BATCH_SCALAR;
+    arg->items = NULL;
+    arg->size = -1;
+    arg->view.obj = NULL;
+    if (PyFloat_Check(object) || PyLong_Check(object)) {
+        arg->scalar = PyFloat_AsDouble(object);
+        if (arg->scalar == -1.0 && PyErr_Occurred()) {
+            return -1;
+        }
+        return 0;
+    }
+    if (PyObject_CheckBuffer(object)) {
+        if (PyObject_GetBuffer(object, &arg->view,
+                               PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        {
+            return -1;
+        }
+        arg->format = batch_format(&arg->view);
+        if (arg->format == 0) {
+            PyErr_Format(PyExc_TypeError, BATCH_FORMAT_ERRMSG, name);
+            PyBuffer_Release(&arg->view);
+            return -1;
+        }
+        if (arg->view.ndim > 1) {
+            PyErr_Format(PyExc_TypeError, BATCH_SHAPE_ERRMSG, name);
+            PyBuffer_Release(&arg->view);
+            return -1;
+        }
+        if (arg->view.ndim == 0) {
+            /* A 0-d buffer, like a NumPy scalar, is a scalar. */
+            arg->scalar = batch_buffer_item(&arg->view, arg->format, 0);
+            PyBuffer_Release(&arg->view);
+            return 0;
+        }
+        arg->kind = BATCH_BUFFER;
+        arg->size = arg->view.len / arg->view.itemsize;
+        return 0;
+    }
+    arg->items = PySequence_Fast(object, name);
+    if (arg->items == NULL) {
+        return -1;
+    }
+    arg->kind = BATCH_SEQUENCE;
+    arg->size = PySequence_Fast_GET_SIZE(arg->items);
+    return 0;
+}
+
+Py_LOCAL_INLINE(void)
+batch_arg_release(batch_arg *arg)
+{
+    if (arg->kind == BATCH_BUFFER) {
+        PyBuffer_Release(&arg->view);
+    }
+    Py_CLEAR(arg->items);
+    arg->kind = BATCH_SCALAR;
+}
+
+/*
+** Return a new reference to the item i of the sequence made by
+** PySequence_Fast. Return NULL with an exception set if the sequence was
+** shortened by another thread.
+*/
+Py_LOCAL_INLINE(PyObject *)
+batch_sequence_item(PyObject *items, Py_ssize_t i)
+{
+    PyObject *item = NULL;
+    BATCH_BEGIN_SEQUENCE(items);
+    if (i < PySequence_Fast_GET_SIZE(items)) {
+        item = PySequence_Fast_GET_ITEM(items, i);
+        Py_INCREF(item);
+    }
+    BATCH_END_SEQUENCE();
+    if (item == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, BATCH_CHANGED_ERRMSG);
+    }
+    return item;
+}
+
+/*
+** Return the item i of the argument, the scalar value for a scalar.
+** Return -1.0 with an exception set if a sequence item isn't a number.
+*/
+Py_LOCAL_INLINE(double)
+batch_arg_item(const batch_arg *arg, Py_ssize_t i)
+{
+    if (arg->kind == BATCH_BUFFER) {
+        return batch_buffer_item(&arg->view, arg->format, i);
+    }
+    if (arg->kind == BATCH_SEQUENCE) {
+        PyObject *item = batch_sequence_item(arg->items, i);
+        double v;
+        if (item == NULL) {
+            return -1.0;
+        }
+        v = PyFloat_AsDouble(item);
+        Py_DECREF(item);
+        return v;
+    }
+    return arg->scalar;
+}
+
+/*
+** Write the n items of the argument starting at the item start in values,
+** truncated to integers, the scalar value n times for a scalar. A buffer
+** of longs is copied and the integers of a sequence are read without
+** going through a float. Return -1 with an exception set if an item isn't
+** a number or doesn't fit in a long.
+*/
+Py_LOCAL_INLINE(int)
+batch_arg_longs(const batch_arg *arg, Py_ssize_t start, Py_ssize_t n,
+                long *values)
+{
+    Py_ssize_t i;
+    if (arg->kind == BATCH_BUFFER && arg->format == 'l') {
+        memcpy(values, (const long *)arg->view.buf + start,
+               (size_t)n * sizeof(long));
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        double v;
+        if (arg->kind == BATCH_SEQUENCE) {
+            PyObject *item = batch_sequence_item(arg->items, start + i);
+            if (item == NULL) {
+                return -1;
+            }
+            if (PyLong_Check(item)) {
+                values[i] = PyLong_AsLong(item);
+                Py_DECREF(item);
+                if (values[i] == -1 && PyErr_Occurred()) {
+                    return -1;
+                }
+                continue;
+            }
+            v = PyFloat_AsDouble(item);
+            Py_DECREF(item);
+            if (v == -1.0 && PyErr_Occurred()) {
+                return -1;
+            }
+        }
+        else {
+            v = batch_arg_item(arg, start + i);
+        }
+        if (!BATCH_FITS(v, LONG_MIN, LONG_MAX)) {
+            PyErr_Format(PyExc_OverflowError, BATCH_LONG_RANGE_ERRMSG,
+                         start + i);
+            return -1;
+        }
+        values[i] = (long)v;
+    }
+    return 0;
+}
+
+/*
+** Return the number of items of the batch made by the arguments, -1 if
+** all of them are scalars. Return -2 with an exception set if the
+** arguments which aren't scalars have different sizes.
+*/
+Py_LOCAL_INLINE(Py_ssize_t)
+batch_size(batch_arg *args, int n_args)
+{
+    Py_ssize_t size = -1;
+    int i;
+    for (i = 0; i < n_args; i++) {
+        if (args[i].size < 0) {
+            continue;
+        }
+        if (size >= 0 && args[i].size != size) {
+            PyErr_Format(PyExc_ValueError, BATCH_SIZE_ERRMSG,
+                         size, args[i].size);
+            return -2;
+        }
+        size = args[i].size;
+    }
+    return size;
+}
+
+/*
+** Return -1 with an exception set if an output object is given for a
+** result which isn't a batch (all the arguments are numbers).
+*/
+Py_LOCAL_INLINE(int)
+batch_out_none(PyObject *object)
+{
+    if (object != NULL && object != Py_None) {
+        PyErr_SetString(PyExc_TypeError, BATCH_OUT_SCALAR_ERRMSG);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** Initialize the output of the given size. If the object is None, a new
+** buffer with the given format is created, otherwise the object must
+** export a writable buffer of the given size with a supported format.
+** Return -1 with an exception set on failure.
+*/
+Py_LOCAL_INLINE(int)
+batch_out_init(batch_out *out, PyObject *object, Py_ssize_t size,
+               char format)
+{
+    out->view.obj = NULL;
+    out->result = NULL;
+    if (object == NULL || object == Py_None) {
+        PyObject *bytes, *view;
+        char type[2] = {format, 0};
+        Py_ssize_t itemsize = format == 'd' ? sizeof(double) :
+                                              sizeof(long long);
+        bytes = PyByteArray_FromStringAndSize(NULL, size * itemsize);
+        if (bytes == NULL) {
+            return -1;
+        }
+        view = PyMemoryView_FromObject(bytes);
+        Py_DECREF(bytes);
+        if (view == NULL) {
+            return -1;
+        }
+        out->result = PyObject_CallMethod(view, "cast", "s", type);
+        Py_DECREF(view);
+        if (out->result == NULL) {
+            return -1;
+        }
+        object = out->result;
+    }
+    else {
+        Py_INCREF(object);
+        out->result = object;
+    }
+    if (PyObject_GetBuffer(object, &out->view, PyBUF_C_CONTIGUOUS |
+                           PyBUF_FORMAT | PyBUF_WRITABLE) < 0)
+    {
+        Py_CLEAR(out->result);
+        return -1;
+    }
+    out->format = batch_format(&out->view);
+    if (out->format == 0) {
+        PyErr_SetString(PyExc_TypeError, BATCH_OUT_FORMAT_ERRMSG);
+    }
+    else if (out->view.ndim != 1) {
+        PyErr_SetString(PyExc_TypeError, BATCH_OUT_SHAPE_ERRMSG);
+    }
+    else if (out->view.len / out->view.itemsize != size) {
+        PyErr_Format(PyExc_ValueError, BATCH_OUT_SIZE_ERRMSG, size,
+                     out->view.len / out->view.itemsize);
+    }
+    else {
+        return 0;
+    }
+    PyBuffer_Release(&out->view);
+    Py_CLEAR(out->result);
+    return -1;
+}
+
+/*
+** Release the buffer of the output and return the object given to the
+** caller (a new reference), or NULL and release it if failed is true.
+*/
+Py_LOCAL_INLINE(PyObject *)
+batch_out_finish(batch_out *out, int failed)
+{
+    PyObject *result = out->result;
+    if (out->view.obj != NULL) {
+        PyBuffer_Release(&out->view);
+    }
+    out->result = NULL;
+    if (failed) {
+        Py_XDECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+/*
+** Initialize n outputs of the given size from the object, which is None
+** (new buffers are created) or a sequence of n objects exporting writable
+** buffers. Return -1 with an exception set on failure, the outputs being
+** released.
+*/
+Py_LOCAL_INLINE(int)
+batch_outs_init(batch_out *outs, Py_ssize_t n, PyObject *object,
+                Py_ssize_t size, char format)
+{
+    Py_ssize_t i;
+    if (object != Py_None && (!PySequence_Check(object) ||
+                              PySequence_Size(object) != n))
+    {
+        PyErr_Format(PyExc_ValueError, BATCH_OUTS_ERRMSG, n);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        PyObject *item = Py_None;
+        int status;
+        if (object != Py_None) {
+            item = PySequence_GetItem(object, i);
+            if (item == NULL) {
+                break;
+            }
+        }
+        status = batch_out_init(&outs[i], item, size, format);
+        if (object != Py_None) {
+            Py_DECREF(item);
+        }
+        if (status < 0) {
+            break;
+        }
+    }
+    if (i < n) {
+        while (i > 0) {
+            i -= 1;
+            batch_out_finish(&outs[i], 1);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** Release the buffers of the n outputs and return a new tuple of the
+** objects given to the caller, or NULL and release them if failed is true.
+*/
+Py_LOCAL_INLINE(PyObject *)
+batch_outs_finish(batch_out *outs, Py_ssize_t n, int failed)
+{
+    PyObject *result = failed ? NULL : PyTuple_New(n);
+    Py_ssize_t i;
+    for (i = 0; i < n; i++) {
+        PyObject *item = batch_out_finish(&outs[i], result == NULL);
+        if (result != NULL) {
+            PyTuple_SET_ITEM(result, i, item);
+        }
+    }
+    return result;
+}
+
+/*
+** Write the value at the index i of the output. Return -1 with an
+** exception set if the value doesn't fit in the item type of the output.
+*/
+Py_LOCAL_INLINE(int)
+batch_out_set(batch_out *out, Py_ssize_t i, double v)
+{
+    void *p = out->view.buf;
+    switch (out->format) {
+    case 'b':
+        if (BATCH_FITS(v, SCHAR_MIN, SCHAR_MAX)) {
+            ((signed char *)p)[i] = (signed char)v;
+            return 0;
+        }
+        break;
+    case 'B':
+        if (BATCH_FITS(v, 0, UCHAR_MAX)) {
+            ((unsigned char *)p)[i] = (unsigned char)v;
+            return 0;
+        }
+        break;
+    case 'h':
+        if (BATCH_FITS(v, SHRT_MIN, SHRT_MAX)) {
+            ((short *)p)[i] = (short)v;
+            return 0;
+        }
+        break;
+    case 'H':
+        if (BATCH_FITS(v, 0, USHRT_MAX)) {
+            ((unsigned short *)p)[i] = (unsigned short)v;
+            return 0;
+        }
+        break;
+    case 'i':
+        if (BATCH_FITS(v, INT_MIN, INT_MAX)) {
+            ((int *)p)[i] = (int)v;
+            return 0;
+        }
+        break;
+    case 'I':
+        if (BATCH_FITS(v, 0, UINT_MAX)) {
+            ((unsigned int *)p)[i] = (unsigned int)v;
+            return 0;
+        }
+        break;
+    case 'l':
+        if (BATCH_FITS(v, LONG_MIN, LONG_MAX)) {
+            ((long *)p)[i] = (long)v;
+            return 0;
+        }
+        break;
+    case 'L':
+        if (BATCH_FITS(v, 0, ULONG_MAX)) {
+            ((unsigned long *)p)[i] = (unsigned long)v;
+            return 0;
+        }
+        break;
+    case 'q':
+        if (BATCH_FITS(v, LLONG_MIN, LLONG_MAX)) {
+            ((long long *)p)[i] = (long long)v;
+            return 0;
+        }
+        break;
+    case 'Q':
+        if (BATCH_FITS(v, 0, ULLONG_MAX)) {
+            ((unsigned long long *)p)[i] = (unsigned long long)v;
+            return 0;
+        }
+        break;
+    case 'f':
+        if (v >= -FLT_MAX && v <= FLT_MAX) {
+            ((float *)p)[i] = (float)v;
+            return 0;
+        }
+        break;
+    default:
+        ((double *)p)[i] = v;
+        return 0;
+    }
+    PyErr_Format(PyExc_OverflowError, BATCH_OUT_RANGE_ERRMSG, i,
+                 out->format);
+    return -1;
+}
+
+#endif
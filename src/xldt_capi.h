@@ -0,0 +1,90 @@
+#ifndef __XLDT_CAPI_H__
+#define __XLDT_CAPI_H__
+
+/*
+** The C API of the module, for other extensions needing the same serial
+** numbers without calling the Python functions. The module exports a
+** capsule named XLDT_CAPSULE_NAME holding a pointer to a XLDT_CAPI table.
+** New entries are only appended at the end of the table and increase
+** XLDT_CAPI_VERSION, so that a table with a greater version can be used by
+** code compiled against an older header.
+** This header only declares names starting with XLDT_ (or xldt_), it can
+** be included from C or C++.
+**
+** Usage from an extension:
+**
+**     const XLDT_CAPI *capi = XLDT_ImportCAPI();
+**     if (capi == NULL) {
+**         return NULL;
+**     }
+**     capi->serial_to_date(serial, &year, &month, &day);
+**
+** The array kernels (version 4) work on C arrays. The module functions
+** taking buffers and sequences of Python objects aren't in the table, an
+** extension holding such objects calls them through Python.
+*/
+
+#ifndef Py_PYTHON_H
+#error The Python header must be included before this header.
+#endif
+
+#define XLDT_CAPSULE_NAME "xldt._C_API"
+
+#define XLDT_CAPI_VERSION 4
+
+/*
+** The week types (XLDT_SUN_1...), the DATEDIF units (XLDT_DIF_D...) and
+** the xldt_date_fields structure are those of the native library.
+*/
+#include "xldt.h"
+
+/*
+** A serial number with the year, month and day of its date.
+*/
+typedef struct xldt_date_fields XLDT_DateFields;
+
+typedef struct {
+    /* The version of the table, XLDT_CAPI_VERSION when it was exported. */
+    int version;
+    void (*serial_to_date)(long serial, long *year, long *month, long *day);
+    long (*date_as_serial)(long year, long month, long day);
+    long (*serial_as_weekday)(long serial, long type);
+    long (*serial_as_week)(long serial, long type);
+    /* Version 2 */
+    void (*serial_to_fields)(long serial, XLDT_DateFields *date);
+    long (*fields_difference)(const XLDT_DateFields *start,
+                              const XLDT_DateFields *end, long unit);
+    /* Version 3 */
+    long (*fields_as_isoweek)(const XLDT_DateFields *date, long *iso_year);
+    long (*isocalendar_as_serial)(long iso_year, long iso_week,
+                                  long iso_weekday);
+    /* Version 4 */
+    void (*serials_to_fields)(const long *serials, size_t n,
+                              XLDT_DateFields *dates);
+    void (*dates_as_serials)(const long *years, const long *months,
+                             const long *days, size_t n, long *serials);
+    void (*fields_differences)(const XLDT_DateFields *starts,
+                               const XLDT_DateFields *ends, size_t n,
+                               long unit, long *results);
+} XLDT_CAPI;
+
+/*
+** Import the module and return its C API table. Return NULL with an
+** exception set if the module can't be imported or if its table is older
+** than the one this header describes.
+*/
+Py_LOCAL_INLINE(const XLDT_CAPI *)
+XLDT_ImportCAPI(void)
+{
+    const XLDT_CAPI *capi =
+        (const XLDT_CAPI *)PyCapsule_Import(XLDT_CAPSULE_NAME, 0);
+    if (capi != NULL && capi->version < XLDT_CAPI_VERSION) {
+        PyErr_Format(PyExc_ImportError,
+                     "xldt C API version %d is older than %d",
+                     capi->version, XLDT_CAPI_VERSION);
+        return NULL;
+    }
+    return capi;
+}
+
+#endif
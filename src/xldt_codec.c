@@ -0,0 +1,383 @@
+#include <string.h>
+
+#include "xldt_codec.h"
+
+static const unsigned char CODEC_MAGIC[4] = {'X', 'L', 'D', 'T'};
+
+/*
+** Write the n low bytes of the value in little endian order.
+*/
+static void
+put_le(unsigned char *p, unsigned long long v, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+/*
+** Return the value of n bytes stored in little endian order.
+*/
+static unsigned long long
+get_le(const unsigned char *p, int n)
+{
+    unsigned long long v = 0;
+    int i;
+    for (i = n - 1; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/*
+** Write the value as a varint (7 bits per byte, the high bit set on all
+** the bytes but the last one), after mapping the signed values to
+** unsigned ones with zigzag encoding (0, -1, 1, -2, 2...). Return the
+** address following the varint.
+*/
+static unsigned char *
+put_varint(unsigned char *p, long long v)
+{
+    unsigned long long u = v < 0 ? ~((unsigned long long)v << 1) :
+                                   (unsigned long long)v << 1;
+    while (u >= 0x80) {
+        *p++ = (unsigned char)(u | 0x80);
+        u >>= 7;
+    }
+    *p++ = (unsigned char)u;
+    return p;
+}
+
+/*
+** Read a varint written by 'put_varint' and return the address following
+** it, or NULL if it doesn't end before the end address.
+*/
+static const unsigned char *
+get_varint(const unsigned char *p, const unsigned char *end, long long *v)
+{
+    unsigned long long u = 0;
+    int shift = 0;
+    while (p < end && shift < 64) {
+        unsigned char b = *p++;
+        u |= (unsigned long long)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            *v = (u & 1) ? (long long)~(u >> 1) : (long long)(u >> 1);
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+/*
+** Return the number of bits needed to store the value.
+*/
+static int
+bit_width(unsigned long long v)
+{
+    int width = 0;
+    while (v != 0) {
+        width += 1;
+        v >>= 1;
+    }
+    return width;
+}
+
+/*
+** Return the value packed at the position: the value itself, or its
+** difference with the next one when packing deltas.
+*/
+static unsigned long long
+frame_value(const long long *values, size_t i, int delta)
+{
+    if (delta) {
+        return (unsigned long long)values[i + 1] -
+               (unsigned long long)values[i];
+    }
+    return (unsigned long long)values[i];
+}
+
+/*
+** Return the minimum of the n values (or deltas) and write the number of
+** bits needed for their differences with it.
+*/
+static long long
+frame_reference(const long long *values, size_t n, int delta, int *width)
+{
+    unsigned long long low = frame_value(values, 0, delta), range = 0;
+    size_t i;
+    for (i = 1; i < n; i++) {
+        unsigned long long v = frame_value(values, i, delta);
+        if ((long long)v < (long long)low) {
+            low = v;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        unsigned long long v = frame_value(values, i, delta) - low;
+        if (v > range) {
+            range = v;
+        }
+    }
+    *width = bit_width(range);
+    return (long long)low;
+}
+
+/*
+** Write n values (or deltas) minus the reference on width bits each,
+** least significant bits first. Return the address following the last
+** byte written.
+*/
+static unsigned char *
+pack_bits(unsigned char *p, const long long *values, size_t n, int delta,
+          long long reference, int width)
+{
+    unsigned long long acc = 0;
+    int bits = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        unsigned long long v = frame_value(values, i, delta) -
+                               (unsigned long long)reference;
+        int left = width;
+        /* At most 32 bits are added to the at most 7 pending bits. */
+        while (left > 0) {
+            int take = left > 32 ? 32 : left;
+            acc |= (v & ((1ULL << take) - 1)) << bits;
+            bits += take;
+            v >>= take;
+            left -= take;
+            while (bits >= 8) {
+                *p++ = (unsigned char)acc;
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+    }
+    if (bits > 0) {
+        *p++ = (unsigned char)acc;
+    }
+    return p;
+}
+
+/*
+** Read n values written by 'pack_bits' (the caller checks that the data
+** is long enough) and add the reference to them.
+*/
+static const unsigned char *
+unpack_bits(const unsigned char *p, long long *values, size_t n,
+            long long reference, int width)
+{
+    unsigned long long acc = 0;
+    int bits = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        unsigned long long v = 0;
+        int left = width, shift = 0;
+        while (left > 0) {
+            int take = left > 32 ? 32 : left;
+            while (bits < take) {
+                acc |= (unsigned long long)*p++ << bits;
+                bits += 8;
+            }
+            v |= (acc & ((1ULL << take) - 1)) << shift;
+            acc >>= take;
+            bits -= take;
+            shift += take;
+            left -= take;
+        }
+        values[i] = (long long)(v + (unsigned long long)reference);
+    }
+    return p;
+}
+
+/*
+** Return the number of blocks of the data described by the header.
+*/
+size_t
+codec_blocks(const codec_header *header)
+{
+    return (size_t)((header->count + header->block_size - 1) /
+                    header->block_size);
+}
+
+/*
+** Return the size of the index of the data described by the header.
+*/
+size_t
+codec_index_size(const codec_header *header)
+{
+    return (codec_blocks(header) + 1) * 8;
+}
+
+/*
+** Return the maximum size of the n serials of a block.
+*/
+size_t
+codec_block_bound(size_t n, unsigned int flags)
+{
+    /* A varint takes at most 10 bytes, a packed value at most 8. */
+    size_t size = 10 + 10 + 1 + 8 * n;
+    if (flags & CODEC_TIME) {
+        size += 10 + 1 + 8 * n;
+    }
+    return size;
+}
+
+void
+codec_write_header(const codec_header *header, unsigned char *data)
+{
+    memcpy(data, CODEC_MAGIC, sizeof(CODEC_MAGIC));
+    data[4] = CODEC_VERSION;
+    data[5] = (unsigned char)header->flags;
+    put_le(data + 6, 0, 2);
+    put_le(data + 8, header->resolution, 4);
+    put_le(data + 12, header->block_size, 4);
+    put_le(data + 16, header->count, 8);
+}
+
+/*
+** Read the header of the data of the given size. Return -1 if the data
+** isn't in the format or if it is too short to hold the index.
+*/
+int
+codec_read_header(const unsigned char *data, size_t size,
+                  codec_header *header)
+{
+    if (size < CODEC_HEADER_SIZE ||
+        memcmp(data, CODEC_MAGIC, sizeof(CODEC_MAGIC)) != 0 ||
+        data[4] != CODEC_VERSION || (data[5] & ~CODEC_TIME) != 0)
+    {
+        return -1;
+    }
+    header->flags = data[5];
+    header->resolution = (unsigned long)get_le(data + 8, 4);
+    header->block_size = (size_t)get_le(data + 12, 4);
+    header->count = get_le(data + 16, 8);
+    if (header->block_size == 0 ||
+        ((header->flags & CODEC_TIME) != 0) != (header->resolution != 0) ||
+        header->count / header->block_size > (size - CODEC_HEADER_SIZE) / 8)
+    {
+        return -1;
+    }
+    if ((size - CODEC_HEADER_SIZE) / 8 < codec_blocks(header) + 1) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+** Write the offset of the block (the block count for the end of the last
+** block) in the index, which has 'codec_index_size' bytes.
+*/
+void
+codec_write_offset(unsigned char *index, size_t block,
+                   unsigned long long offset)
+{
+    put_le(index + 8 * block, offset, 8);
+}
+
+/*
+** Write the offsets of the start and the end of the block. Return -1 if
+** they are out of the data.
+*/
+int
+codec_block_range(const unsigned char *data, size_t size,
+                  const codec_header *header, size_t block,
+                  size_t *start, size_t *end)
+{
+    /* 'codec_read_header' checked that the index fits in the size. */
+    size_t blocks_end = size - codec_index_size(header);
+    const unsigned char *index = data + blocks_end + 8 * block;
+    unsigned long long first, last;
+    if (block >= codec_blocks(header)) {
+        return -1;
+    }
+    first = get_le(index, 8);
+    last = get_le(index + 8, 8);
+    if (first < CODEC_HEADER_SIZE || first > last || last > blocks_end) {
+        return -1;
+    }
+    *start = (size_t)first;
+    *end = (size_t)last;
+    return 0;
+}
+
+/*
+** Encode the n days (and ticks, if not NULL) of a block at the address
+** given, which must have at least 'codec_block_bound' bytes. Return the
+** size of the encoded block.
+*/
+size_t
+codec_encode_block(const long long *days, const long long *ticks,
+                   size_t n, unsigned char *out)
+{
+    unsigned char *p = out;
+    long long reference;
+    int width;
+    if (n == 0) {
+        return 0;
+    }
+    p = put_varint(p, days[0]);
+    if (n > 1) {
+        reference = frame_reference(days, n - 1, 1, &width);
+        p = put_varint(p, reference);
+        *p++ = (unsigned char)width;
+        p = pack_bits(p, days, n - 1, 1, reference, width);
+    }
+    if (ticks != NULL) {
+        reference = frame_reference(ticks, n, 0, &width);
+        p = put_varint(p, reference);
+        *p++ = (unsigned char)width;
+        p = pack_bits(p, ticks, n, 0, reference, width);
+    }
+    return (size_t)(p - out);
+}
+
+/*
+** Decode the n days (and ticks, if not NULL) of the block of the given
+** size. Return -1 if the block is corrupted.
+*/
+int
+codec_decode_block(const unsigned char *data, size_t size, size_t n,
+                   long long *days, long long *ticks)
+{
+    const unsigned char *p = data, *end = data + size;
+    long long low;
+    int width;
+    size_t i;
+    if (n == 0) {
+        return 0;
+    }
+    p = get_varint(p, end, &days[0]);
+    if (p == NULL) {
+        return -1;
+    }
+    if (n > 1) {
+        p = get_varint(p, end, &low);
+        if (p == NULL || p >= end) {
+            return -1;
+        }
+        width = *p++;
+        if (width > 64 || (size_t)(end - p) < ((n - 1) * width + 7) / 8) {
+            return -1;
+        }
+        /* Decode the deltas in place, then accumulate them. */
+        p = unpack_bits(p, days + 1, n - 1, low, width);
+        for (i = 1; i < n; i++) {
+            days[i] = (long long)((unsigned long long)days[i - 1] +
+                                  (unsigned long long)days[i]);
+        }
+    }
+    if (ticks != NULL) {
+        p = get_varint(p, end, &low);
+        if (p == NULL || p >= end) {
+            return -1;
+        }
+        width = *p++;
+        if (width > 64 || (size_t)(end - p) < (n * width + 7) / 8) {
+            return -1;
+        }
+        unpack_bits(p, ticks, n, low, width);
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef __XLDT_CODEC_H__
+#define __XLDT_CODEC_H__
+
+#include "xldt.h"
+
+/*
+** The codec of the module (the format is described in xldt.h). Like the
+** calendar core it doesn't depend on Python. This header is private to
+** the module, it gives the short names used in its sources to the
+** exported functions and constants.
+*/
+
+#define CODEC_HEADER_SIZE XLDT_CODEC_HEADER_SIZE
+#define CODEC_VERSION XLDT_CODEC_VERSION
+#define CODEC_TIME XLDT_CODEC_TIME
+#define CODEC_MAX_SIZE XLDT_CODEC_MAX_SIZE
+
+typedef xldt_codec_header codec_header;
+
+#define codec_blocks xldt_codec_blocks
+#define codec_index_size xldt_codec_index_size
+#define codec_block_bound xldt_codec_block_bound
+#define codec_write_header xldt_codec_write_header
+#define codec_read_header xldt_codec_read_header
+#define codec_write_offset xldt_codec_write_offset
+#define codec_block_range xldt_codec_block_range
+#define codec_encode_block xldt_codec_encode_block
+#define codec_decode_block xldt_codec_decode_block
+
+#endif
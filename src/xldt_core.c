@@ -0,0 +1,709 @@
+#include <math.h>
+
+#include "xldt_core.h"
+
+/*
+** The number of days contained in the given number of months of a non-leap
+** year is stored in the array below.
+*/
+static const long DAYS_IN_MONTHS[] = {
+    0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365
+};
+
+/*
+** Return the nearest lesser integer regardless of the sign of the value.
+*/
+long
+x_floor(double v)
+{
+    return (long)floor(v);
+}
+
+/*
+** Round to the nearest integer when the decimal part is not 0.5 and to the
+** nearest even integer when the decimal part is exactly 0.5.
+*/
+long
+x_round(double v)
+{
+    long x = (long)round(v);
+    if (x < v) {
+        double d = v - x;
+        if (d > 0.5 || (d == 0.5 && x % 2 != 0)) {
+            return x + 1;
+        }
+    }
+    else if (x > v) {
+        double d = x - v;
+        if (d > 0.5 || (d == 0.5 && x % 2 != 0)) {
+            return x - 1;
+        }
+    }
+    return x;
+}
+
+/*
+** Return the quotient of the Euclidean division between n and d.
+*/
+static long
+x_quotient(long n, long d)
+{
+    if (n < 0) {
+        if (d < 0) {
+            return (- n - 1) / (- d) + 1;
+        }
+        return - ((- n - 1) / d) - 1;
+    }
+    if (d < 0) {
+        return - (n / (- d));
+    }
+    return n / d;
+}
+
+/*
+** Return the remainder of the Euclidean division between n and d.
+*/
+long
+x_remainder(long n, long d)
+{
+    return n - d * x_quotient(n, d);
+}
+
+/*
+** Return the number of days passed between the 1st January BASE_YEAR and
+** the 1st January of the given year. The result is negative for the years
+** before BASE_YEAR.
+*/
+static long
+days_before_year(long year)
+{
+    long n_cycles = 0, n_days = 0, n_years = year - BASE_YEAR;
+    if (n_years < 0) {
+        n_cycles = x_quotient(n_years, 400);
+        n_years -= n_cycles * 400;
+        n_days += n_cycles * DAYS_IN_400_YEARS;
+    }
+    return n_days + DAYS_IN_YEARS(n_years);
+}
+
+/*
+** Return the number of days passed between the 1st January and the 1st of
+** the given month (1 - 12) of the year.
+** Return -1 if the month number isn't valid.
+*/
+static long
+year_days_before_month(long year, long month)
+{
+    long days = -1;
+    if (month >= 1 || month <= MONTHS_IN_YEAR) {
+        days = DAYS_IN_MONTHS[month - 1];
+        if (month > 2 && IS_LEAP(year)) {
+            days += 1;
+        }
+    }
+    return days;
+}
+
+/*
+** Write the year, month and day corresponding to the serial number at the
+** addresses given as arguments (can't be NULL).
+*/
+void
+serial_to_date(long serial, long *year, long *month, long *day)
+{
+    long n, n_days;
+    /* Translate to absolute serial (where 1 is 1st January of BASE_YEAR) */
+    serial += BASE_OFFSET;
+    n_days = serial - 1;
+    *year = BASE_YEAR;
+    n = x_quotient(n_days, DAYS_IN_400_YEARS);
+    *year += n * 400;
+    n_days -= n * DAYS_IN_400_YEARS;
+    n = x_quotient(n_days, DAYS_IN_100_YEARS);
+    n -= n >> 2;
+    *year += n * 100;
+    n_days -= n * DAYS_IN_100_YEARS;
+    n = x_quotient(n_days, DAYS_IN_4_YEARS);
+    *year += n * 4;
+    n_days -= n * DAYS_IN_4_YEARS;
+    n = x_quotient(n_days, DAYS_IN_YEAR);
+    n -= n >> 2;
+    *year += n;
+    n_days -= n * DAYS_IN_YEAR;
+    *month = 1 + n_days / 31;
+    if (*month < MONTHS_IN_YEAR && 
+        n_days >= year_days_before_month(*year, *month + 1)) 
+    {
+        *month += 1;
+    }
+    n_days -= year_days_before_month(*year, *month);
+    *day = n_days + 1;
+}
+
+/*
+** Return the serial corresponding to the given year, month and day, so that
+** 1 corresponds to 1899-12-31.
+*/
+long
+date_as_serial(long year, long month, long day)
+{
+    if (month < 1 || month > MONTHS_IN_YEAR) {
+        long n_years;
+        n_years = x_quotient(month - 1, MONTHS_IN_YEAR);
+        year += n_years;
+        month -= n_years * MONTHS_IN_YEAR;
+    }
+    day += year_days_before_month(year, month);
+    day += days_before_year(year);
+    /* Return translation from absolute serial */
+    return day - BASE_OFFSET;
+}
+
+/*
+** Return the weekday according to the week type values defined above.
+** Return -1 if the type isn't valid.
+*/
+long
+serial_as_weekday(long serial, long type)
+{
+    /*
+    ** Since the 1st January 2001 was a Monday and 2001 is a first year of
+    ** a cycle, BASE_YEAR (which must be a first year of a cycle) has the
+    ** 1st January on a Monday.
+    ** It is at BASE_OFFSET days before the date represented by serial 1.
+    */
+    long base = 1 - BASE_OFFSET, days;
+    /* Translate the base according to the required result type. */
+    if (type == SUN_1) {
+        base -= 1;
+    }
+    else if (MON_1_EXT <= type && type <= SUN_1_EXT) {
+        base += type - MON_1_EXT;
+    }
+    else if (type != MON_0 && type != MON_1) {
+        return -1;
+    }
+    days = serial - base;
+    days = x_remainder(days, DAYS_IN_WEEK);
+    if (type == MON_0) {
+        return days;
+    }
+    return days + 1;
+}
+
+
+/*
+** Return the week number according to the week type value defined above or
+** to the values used by the 'serial_as_weekday' function.
+** Return 0 if the type isn't valid.
+*/
+long
+serial_as_week(long serial, long type)
+{
+    long base, day, month, year;
+    serial_to_date(serial, &year, &month, &day);
+    if (type == SUN_1 || 
+        type == MON_1 || (type >= MON_1_EXT && type <= SUN_1_EXT))
+    {
+        base = date_as_serial(year, 1, 1);
+        base -= serial_as_weekday(base, type) - 1;
+        return (serial - base) / DAYS_IN_WEEK + 1;
+    }
+    if (type == MON_2) {
+        date_fields date;
+        date.serial = serial;
+        date.year = year;
+        date.month = month;
+        date.day = day;
+        return fields_as_isoweek(&date, &year);
+    }
+    return 0;
+}
+
+/*
+** Write the serial number of the date and the number of seconds of the
+** time (0 - 86399) corresponding to the value at the addresses given as
+** arguments (can't be NULL). The seconds are rounded like 'x_round' does,
+** a time rounded to 86400 seconds is carried over to the next day.
+*/
+void
+value_to_serial(double value, long *serial, long *second)
+{
+    *serial = x_floor(value);
+    *second = x_round((value - *serial) * SECONDS_IN_DAY);
+    if (*second >= SECONDS_IN_DAY) {
+        *serial += 1;
+        *second -= SECONDS_IN_DAY;
+    }
+}
+
+/*
+** Write the serial number and the corresponding year, month and day in the
+** structure given as argument (can't be NULL).
+*/
+void
+serial_to_fields(long serial, date_fields *date)
+{
+    date->serial = serial;
+    serial_to_date(serial, &date->year, &date->month, &date->day);
+}
+
+/*
+** Write the fields of the n serials in the array of dates. The date of a
+** serial in the same month as the previous one is found without dividing
+** the serial, so that sorted serials are decomposed the fastest.
+*/
+void
+serials_to_fields(const long *serials, size_t n, date_fields *dates)
+{
+    long first = 0, next = 0, year = 0, month = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        long serial = serials[i];
+        if (serial >= first && serial < next) {
+            dates[i].serial = serial;
+            dates[i].year = year;
+            dates[i].month = month;
+            dates[i].day = serial - first + 1;
+            continue;
+        }
+        serial_to_fields(serial, &dates[i]);
+        year = dates[i].year;
+        month = dates[i].month;
+        first = serial - dates[i].day + 1;
+        next = date_as_serial(year, month + 1, 1);
+    }
+}
+
+/*
+** Write the serials of the n dates given by their components, normalized
+** like 'date_as_serial' does. The start of the month is reused while the
+** year and the month don't change.
+*/
+void
+dates_as_serials(const long *years, const long *months, const long *days,
+                 size_t n, long *serials)
+{
+    long base = 0, year = 0, month = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        if (i == 0 || years[i] != year || months[i] != month) {
+            year = years[i];
+            month = months[i];
+            base = date_as_serial(year, month, 1) - 1;
+        }
+        serials[i] = base + days[i];
+    }
+}
+
+/*
+** Return the difference between the dates in the unit given by one of the
+** DIF_ values defined above:
+** - DIF_D, the number of days
+** - DIF_M, the number of full months
+** - DIF_Y, the number of full years
+** - DIF_MD, the days ignoring the months and the years
+** - DIF_YM, the full months ignoring the years
+** - DIF_YD, the days ignoring the years
+** The last three are calculated like Excel does, including its result for
+** DIF_MD when the day of the end is lesser than the day of the start and
+** the month before the end is shorter than the start day.
+** Return 0 if the unit isn't valid.
+*/
+long
+fields_difference(const date_fields *start, const date_fields *end,
+                  long unit)
+{
+    long delta;
+    switch (unit) {
+    case DIF_D:
+        return end->serial - start->serial;
+    case DIF_M:
+    case DIF_YM:
+        delta = (end->year - start->year) * MONTHS_IN_YEAR + 
+                end->month - start->month;
+        if (start->day > end->day) {
+            delta -= 1;
+        }
+        if (unit == DIF_YM) {
+            delta = x_remainder(delta, MONTHS_IN_YEAR);
+        }
+        return delta;
+    case DIF_Y:
+        delta = end->year - start->year;
+        if (start->month > end->month || (start->month == end->month &&
+                                          start->day > end->day))
+        {
+            delta -= 1;
+        }
+        return delta;
+    case DIF_MD:
+        if (end->day >= start->day) {
+            return end->day - start->day;
+        }
+        return end->serial - date_as_serial(end->year, end->month - 1,
+                                            start->day);
+    case DIF_YD:
+        if (start->month < end->month || (start->month == end->month &&
+                                          start->day <= end->day))
+        {
+            return end->serial - date_as_serial(end->year, start->month,
+                                                start->day);
+        }
+        return end->serial - date_as_serial(end->year - 1, start->month,
+                                            start->day);
+    }
+    return 0;
+}
+
+/*
+** Write the differences between the n pairs of dates in the unit, like
+** 'fields_difference' does.
+*/
+void
+fields_differences(const date_fields *starts, const date_fields *ends,
+                   size_t n, long unit, long *results)
+{
+    size_t i;
+    for (i = 0; i < n; i++) {
+        results[i] = fields_difference(&starts[i], &ends[i], unit);
+    }
+}
+
+/*
+** Return the serial number of the Monday of the ISO week 1 of the year,
+** the week containing the first Thursday of the year.
+*/
+static long
+iso_week_start(long year)
+{
+    long base = date_as_serial(year, 1, 1);
+    long wday = serial_as_weekday(base, MON_1);
+    if (wday <= 4) {
+        return base - (wday - 1);
+    }
+    return base + DAYS_IN_WEEK - wday + 1;
+}
+
+/*
+** Return the ISO week number of the date and write its ISO year, which
+** differs from the year of the date for the days of the first and the
+** last week of the year, at the address given as argument (can't be NULL).
+*/
+long
+fields_as_isoweek(const date_fields *date, long *iso_year)
+{
+    long base;
+    *iso_year = date->year;
+    base = iso_week_start(date->year);
+    if (date->serial < base) {
+        *iso_year -= 1;
+        base = iso_week_start(*iso_year);
+    }
+    else if (date->month == MONTHS_IN_YEAR && date->day > 28) {
+        long next = iso_week_start(date->year + 1);
+        if (date->serial >= next) {
+            *iso_year += 1;
+            base = next;
+        }
+    }
+    return (date->serial - base) / DAYS_IN_WEEK + 1;
+}
+
+/*
+** Return the serial number of the date given by its ISO year, ISO week and
+** ISO weekday (1 for Monday to 7 for Sunday). The weeks and the weekdays
+** out of range are carried over to the previous or the next ones.
+*/
+long
+isocalendar_as_serial(long iso_year, long iso_week, long iso_weekday)
+{
+    return iso_week_start(iso_year) + (iso_week - 1) * DAYS_IN_WEEK +
+           iso_weekday - 1;
+}
+
+/*
+** Return the serial number of the last day of the fiscal year (numbered
+** with the calendar year in which it ends) of the calendar.
+*/
+static long
+fiscal_year_end(const fiscal_calendar *calendar, long year)
+{
+    /* The last day of the month before the start month. */
+    long last = date_as_serial(year, calendar->start_month, 0), delta;
+    if (calendar->start_month == 1) {
+        last = date_as_serial(year, MONTHS_IN_YEAR + 1, 0);
+    }
+    if (calendar->pattern == FISCAL_MONTHS) {
+        return last;
+    }
+    /* Move back to the weekday, or to the nearest one. */
+    delta = x_remainder(serial_as_weekday(last, MON_1) - calendar->weekday,
+                        DAYS_IN_WEEK);
+    if (calendar->nearest && delta > 3) {
+        delta -= DAYS_IN_WEEK;
+    }
+    return last - delta;
+}
+
+/*
+** Write the year and the first days of the periods of the fiscal year of
+** the calendar in the structure given as argument (can't be NULL).
+*/
+void
+fiscal_year_bounds(const fiscal_calendar *calendar, long year,
+                   fiscal_year *bounds)
+{
+    static const long weeks[][3] = {{4, 4, 5}, {4, 5, 4}, {5, 4, 4}};
+    long i, start = fiscal_year_end(calendar, year - 1) + 1;
+    bounds->year = year;
+    bounds->starts[FISCAL_PERIODS] = fiscal_year_end(calendar, year) + 1;
+    for (i = 0; i < FISCAL_PERIODS; i++) {
+        bounds->starts[i] = start;
+        if (calendar->pattern == FISCAL_MONTHS) {
+            start = date_as_serial(year - (calendar->start_month > 1),
+                                   calendar->start_month + i + 1, 1);
+        }
+        else {
+            start += weeks[calendar->pattern - 1][i % 3] * DAYS_IN_WEEK;
+        }
+    }
+}
+
+/*
+** Return the fiscal year of the serial number and write its quarter (1 -
+** 4), period (1 - 12) and week (1 - 53) in the fiscal year at the
+** addresses given as arguments (can't be NULL). The bounds are those of
+** the fiscal year returned: they are reused without computation if they
+** already contain the serial number, which makes the calls on sorted
+** serial numbers fast. They must be initialized with a year of 0 or by a
+** previous call.
+*/
+long
+serial_to_fiscal(const fiscal_calendar *calendar, long serial,
+                 fiscal_year *bounds, long *quarter, long *period,
+                 long *week)
+{
+    long i;
+    if (bounds->year == 0 || serial < bounds->starts[0] ||
+        serial >= bounds->starts[FISCAL_PERIODS])
+    {
+        long day, month, year;
+        serial_to_date(serial, &year, &month, &day);
+        /* The fiscal year ends at most 6 days away from the month end. */
+        if (calendar->start_month > 1 && month >= calendar->start_month) {
+            year += 1;
+        }
+        fiscal_year_bounds(calendar, year, bounds);
+        if (serial < bounds->starts[0]) {
+            fiscal_year_bounds(calendar, year - 1, bounds);
+        }
+        else if (serial >= bounds->starts[FISCAL_PERIODS]) {
+            fiscal_year_bounds(calendar, year + 1, bounds);
+        }
+    }
+    i = FISCAL_PERIODS - 1;
+    while (serial < bounds->starts[i]) {
+        i -= 1;
+    }
+    *period = i + 1;
+    *quarter = i / 3 + 1;
+    *week = (serial - bounds->starts[0]) / DAYS_IN_WEEK + 1;
+    return bounds->year;
+}
+
+/*
+** Return the quotient of the Euclidean division between n and d > 0.
+*/
+static long long
+ticks_quotient(long long n, long long d)
+{
+    return n < 0 ? -((-n - 1) / d) - 1 : n / d;
+}
+
+/*
+** Return the value as a number of ticks, the time of the day being rounded
+** to the nearest millisecond.
+*/
+long long
+value_as_ticks(double value)
+{
+    double day = floor(value);
+    return (long long)day * TICKS_IN_DAY +
+           (long long)floor((value - day) * TICKS_IN_DAY + 0.5);
+}
+
+/*
+** Return the value corresponding to the number of ticks. Up to 2^53 ticks
+** (about 100 million days) it is the nearest double to the exact value.
+*/
+double
+ticks_as_value(long long ticks)
+{
+    long long day;
+    if (ticks > -(1LL << 53) && ticks < (1LL << 53)) {
+        return (double)ticks / TICKS_IN_DAY;
+    }
+    day = ticks_quotient(ticks, TICKS_IN_DAY);
+    return (double)day + (double)(ticks - day * TICKS_IN_DAY) / TICKS_IN_DAY;
+}
+
+/*
+** Return the length in ticks of a bucket of a fixed unit.
+*/
+static long long
+bucket_length(const bucket_grid *grid)
+{
+    static const long long lengths[] = {
+        0, 1000, 60000, 3600000, TICKS_IN_DAY
+    };
+    return lengths[grid->unit] * grid->multiple;
+}
+
+/*
+** Return the number of months of a bucket of a calendar unit.
+*/
+static long
+bucket_months(const bucket_grid *grid)
+{
+    if (grid->unit == BUCKET_YEAR) {
+        return MONTHS_IN_YEAR * grid->multiple;
+    }
+    if (grid->unit == BUCKET_QUARTER) {
+        return 3 * grid->multiple;
+    }
+    return grid->multiple;
+}
+
+/*
+** Return the number of the month of the date (0 for January of the year 0).
+*/
+static long
+serial_as_month_index(long serial)
+{
+    long day, month, year;
+    serial_to_date(serial, &year, &month, &day);
+    return year * MONTHS_IN_YEAR + month - 1;
+}
+
+/*
+** Return the first day of the week of the given type containing the date.
+*/
+static long
+serial_week_start(long serial, long type)
+{
+    if (type == MON_2) {
+        type = MON_1;
+    }
+    return serial - serial_as_weekday(serial, type) + (type == MON_0 ? 0 : 1);
+}
+
+/*
+** Return the start (in ticks) of the bucket of the grid containing the
+** time given in ticks.
+*/
+long long
+bucket_floor(const bucket_grid *grid, long long ticks)
+{
+    long long anchor = grid->has_origin ? grid->origin : 0;
+    long serial, start;
+    if (grid->unit <= BUCKET_DAY) {
+        long long length = bucket_length(grid);
+        return anchor + ticks_quotient(ticks - anchor, length) * length;
+    }
+    serial = (long)ticks_quotient(ticks, TICKS_IN_DAY);
+    if (grid->unit == BUCKET_WEEK) {
+        long length = DAYS_IN_WEEK * grid->multiple;
+        start = serial_week_start(
+            (long)ticks_quotient(anchor, TICKS_IN_DAY), grid->week_type);
+        start += x_quotient(serial - start, length) * length;
+    }
+    else {
+        long length = bucket_months(grid), month;
+        month = grid->has_origin ?
+            serial_as_month_index((long)ticks_quotient(anchor, TICKS_IN_DAY)) :
+            0;
+        month += x_quotient(serial_as_month_index(serial) - month, length) *
+                 length;
+        start = date_as_serial(0, month + 1, 1);
+    }
+    return start * TICKS_IN_DAY;
+}
+
+/*
+** Return the start of the bucket following the one starting at the given
+** number of ticks (a value of 'bucket_floor').
+*/
+long long
+bucket_next(const bucket_grid *grid, long long start)
+{
+    long serial;
+    if (grid->unit <= BUCKET_DAY) {
+        return start + bucket_length(grid);
+    }
+    if (grid->unit == BUCKET_WEEK) {
+        return start + DAYS_IN_WEEK * grid->multiple * TICKS_IN_DAY;
+    }
+    serial = (long)(start / TICKS_IN_DAY);
+    serial = date_as_serial(0, serial_as_month_index(serial) +
+                               bucket_months(grid) + 1, 1);
+    return serial * TICKS_IN_DAY;
+}
+
+/*
+** Return the start of the first bucket starting at or after the time.
+*/
+long long
+bucket_ceil(const bucket_grid *grid, long long ticks)
+{
+    long long start = bucket_floor(grid, ticks);
+    return start == ticks ? start : bucket_next(grid, start);
+}
+
+/*
+** Return the start of the bucket containing the value, as a value. The
+** value is rounded to a tick to find the bucket, so a value less than half
+** a tick before a bucket start is in the bucket starting there: the
+** previous bucket is then taken, the result never exceeding the value.
+*/
+double
+bucket_floor_value(const bucket_grid *grid, double value)
+{
+    long long start = bucket_floor(grid, value_as_ticks(value));
+    if (ticks_as_value(start) > value) {
+        start = bucket_floor(grid, start - 1);
+    }
+    return ticks_as_value(start);
+}
+
+/*
+** Return the start of the first bucket starting at or after the value,
+** never less than the value (see 'bucket_floor_value').
+*/
+double
+bucket_ceil_value(const bucket_grid *grid, double value)
+{
+    long long start = bucket_ceil(grid, value_as_ticks(value));
+    if (ticks_as_value(start) < value) {
+        start = bucket_next(grid, start);
+    }
+    return ticks_as_value(start);
+}
+
+/*
+** Return the start of the bucket nearest to the value, the later one when
+** the value isn't less than the middle of its bucket.
+*/
+double
+bucket_round_value(const bucket_grid *grid, double value)
+{
+    long long ticks = value_as_ticks(value), start, next;
+    start = bucket_floor(grid, ticks);
+    if (ticks_as_value(start) > value) {
+        start = bucket_floor(grid, start - 1);
+    }
+    next = bucket_next(grid, start);
+    /* The bucket lengths are even numbers of ticks. */
+    return value < ticks_as_value(start + (next - start) / 2) ?
+           ticks_as_value(start) : ticks_as_value(next);
+}
@@ -0,0 +1,169 @@
+#ifndef __XLDT_CORE_H__
+#define __XLDT_CORE_H__
+
+#include "xldt.h"
+
+/*
+** The calendar core of the module. It doesn't depend on Python, so that
+** it can be built as a static library (libxldt_core) and linked into
+** native code sharing the serial numbers of the module. This header is
+** private to the module: native code includes xldt.h, which declares the
+** exported functions with the xldt_ prefix. The macros below give them
+** the short names used in the sources of the module.
+*/
+
+/* 
+** A base year y must be chosen so that y % 400 == 1. It must be lesser
+** than the base year used by Excel (1900).
+*/
+#define BASE_YEAR 1601
+
+/*
+** A normal year has 365 days. Every 4th year is leap if it's not multiple
+** of 100 or if it's multiple of 400. A leap year has 366 days.
+** The second month has 28 days in a normal year, 29 days in a leap year.
+*/
+#define IS_LEAP(y) (((y) % 4 == 0 && (y) % 100 != 0) || (y) % 400 == 0)
+
+/*
+** A cycle of 4 years has 365 * 3 + 366 = 4 * 365 + 1 = 1461 days.
+** The last year of every 25th cycle of 4 years is a multiple of 100, so it
+** isn't leap, it has one day less.
+** A cycle of 100 years has 25 * 1461 - 1 = 36524 days.
+** The last year of every 4th cycle of 100 years is a multiple of 400, so
+** it's leap, it has one more day.
+** A cycle of 400 years has 4 * 36524 + 1 = 146097 days.
+*/
+#define DAYS_IN_YEAR      365
+#define DAYS_IN_4_YEARS   1461
+#define DAYS_IN_100_YEARS 36524
+#define DAYS_IN_400_YEARS 146097
+
+/*
+** The DAYS_IN_YEARS macro calculates the number of full days in the given
+** number of years starting with the 1st January of the BASE_YEAR.
+** The argument must be greater than or equal to 0.
+*/
+#define DAYS_IN_YEARS(n) ((n) * 365 + (n) / 400 - (n) / 100 + (n) / 4)
+
+/*
+** The calendar assigns a serial number to each date.
+** The serial number 1 represents 1899-12-31, so that the numbers produced
+** by this module are identical with those produced by Excel for dates
+** starting with 1900-03-01 when using the 1900 based date system (the
+** identity is lost for previous dates because of Lotus bug, also present
+** in Excel).
+** The base offset is the difference in days between the date corresponding
+** to the serial number 1 and 1st January of BASE_YEAR. It is used for
+** internal calculations.
+*/
+#define BASE_OFFSET (DAYS_IN_YEARS(1900 - BASE_YEAR) - 1)
+
+/*
+** Every year has 12 months.
+*/
+#define MONTHS_IN_YEAR 12
+
+/*
+** Every week has 7 days.
+*/
+#define DAYS_IN_WEEK 7
+
+/*
+** A day has 24 hours, an hour has 60 minutes, a minute has 60 seconds, so
+** an hour has 3600 seconds, a day has 1440 minutes or 86400 seconds.
+*/
+#define HOURS_IN_DAY      24
+#define MINUTES_IN_HOUR   60
+#define MINUTES_IN_DAY    1440
+#define SECONDS_IN_MINUTE 60
+#define SECONDS_IN_HOUR   3600
+#define SECONDS_IN_DAY    86400
+
+/*
+** The week types accepted by 'serial_as_weekday' and 'serial_as_week'.
+*/
+#define SUN_1 XLDT_SUN_1
+#define MON_1 XLDT_MON_1
+#define MON_0 XLDT_MON_0
+#define MON_1_EXT XLDT_MON_1_EXT
+#define TUE_1_EXT XLDT_TUE_1_EXT
+#define WED_1_EXT XLDT_WED_1_EXT
+#define THU_1_EXT XLDT_THU_1_EXT
+#define FRI_1_EXT XLDT_FRI_1_EXT
+#define SAT_1_EXT XLDT_SAT_1_EXT
+#define SUN_1_EXT XLDT_SUN_1_EXT
+#define MON_2 XLDT_MON_2
+
+/*
+** The units accepted by 'fields_difference'.
+*/
+#define DIF_D  XLDT_DIF_D
+#define DIF_M  XLDT_DIF_M
+#define DIF_Y  XLDT_DIF_Y
+#define DIF_MD XLDT_DIF_MD
+#define DIF_YM XLDT_DIF_YM
+#define DIF_YD XLDT_DIF_YD
+
+/*
+** The patterns and the periods of the fiscal calendars.
+*/
+#define FISCAL_MONTHS XLDT_FISCAL_MONTHS
+#define FISCAL_445    XLDT_FISCAL_445
+#define FISCAL_454    XLDT_FISCAL_454
+#define FISCAL_544    XLDT_FISCAL_544
+#define FISCAL_PERIODS XLDT_FISCAL_PERIODS
+
+/*
+** The units of the buckets and the ticks in a day.
+*/
+#define BUCKET_SECOND  XLDT_BUCKET_SECOND
+#define BUCKET_MINUTE  XLDT_BUCKET_MINUTE
+#define BUCKET_HOUR    XLDT_BUCKET_HOUR
+#define BUCKET_DAY     XLDT_BUCKET_DAY
+#define BUCKET_WEEK    XLDT_BUCKET_WEEK
+#define BUCKET_MONTH   XLDT_BUCKET_MONTH
+#define BUCKET_QUARTER XLDT_BUCKET_QUARTER
+#define BUCKET_YEAR    XLDT_BUCKET_YEAR
+#define TICKS_IN_DAY   XLDT_TICKS_IN_DAY
+
+typedef struct xldt_date_fields date_fields;
+typedef xldt_fiscal_calendar fiscal_calendar;
+typedef xldt_fiscal_year fiscal_year;
+typedef xldt_bucket_grid bucket_grid;
+
+/*
+** The helpers shared by the sources of the module, exported with the
+** xldt_ prefix but not declared by xldt.h.
+*/
+long xldt_floor(double v);
+long xldt_round(double v);
+long xldt_remainder(long n, long d);
+
+#define x_floor xldt_floor
+#define x_round xldt_round
+#define x_remainder xldt_remainder
+#define serial_to_date xldt_serial_to_date
+#define date_as_serial xldt_date_as_serial
+#define serial_as_weekday xldt_serial_as_weekday
+#define serial_as_week xldt_serial_as_week
+#define value_to_serial xldt_value_to_serial
+#define serial_to_fields xldt_serial_to_fields
+#define fields_difference xldt_fields_difference
+#define fields_as_isoweek xldt_fields_as_isoweek
+#define isocalendar_as_serial xldt_isocalendar_as_serial
+#define serials_to_fields xldt_serials_to_fields
+#define dates_as_serials xldt_dates_as_serials
+#define fields_differences xldt_fields_differences
+#define fiscal_year_bounds xldt_fiscal_year_bounds
+#define serial_to_fiscal xldt_serial_to_fiscal
+#define value_as_ticks xldt_value_as_ticks
+#define ticks_as_value xldt_ticks_as_value
+#define bucket_floor xldt_bucket_floor
+#define bucket_next xldt_bucket_next
+#define bucket_ceil xldt_bucket_ceil
+#define bucket_floor_value xldt_bucket_floor_value
+#define bucket_ceil_value xldt_bucket_ceil_value
+#define bucket_round_value xldt_bucket_round_value
+
+#endif
@@ -11,11 +11,49 @@ This module manipulates date and time by using serial numbers, like\n\
 Microsoft Excel. The serial numbers are identical between this module\n\
 and Excel for dates starting with 1900-03-01 in the 1900 date system.");
 
+PyDoc_STRVAR(xldt_ceil_to__doc__,
+"ceil_to(value, unit, multiple=1, origin=None, week_start=SUN_1, out=None)\n\n\
+Return the start of the first bucket starting at or after the time given\n\
+by the value.\n\
+The arguments are those of floor_to(), the value can also be a buffer\n\
+or a sequence of numbers.");
+
 PyDoc_STRVAR(xldt_date__doc__,
 "date(year: float, month: float, day: float) -> float\n\n\
 Return the value corresponding to the given date. The month and the\n\
 day are optional, defaulting to 1.");
 
+PyDoc_STRVAR(xldt_datedif__doc__,
+"datedif(start_date, end_date, unit, out=None)\n\n\
+Calculate the difference between the dates like Excel's DATEDIF. The\n\
+unit is one of the strings (in any case):\n\
+* D - The number of days\n\
+* M - The number of full months\n\
+* Y - The number of full years\n\
+* MD - The days, ignoring the months and the years\n\
+* YM - The full months, ignoring the years\n\
+* YD - The days, ignoring the years\n\
+The unit can also be a sequence of these strings, the result is then a\n\
+tuple with one item per unit, all computed with one decomposition of\n\
+each date.\n\
+The dates can be numbers, objects exporting a buffer of numbers (like\n\
+array.array or numpy arrays) or sequences of numbers. A number is used\n\
+with every item of the other date. If both dates are numbers, the\n\
+result is an int, otherwise it is written in the writable buffer given\n\
+as out (a sequence of buffers when there are several units) or in a\n\
+new memoryview of 64 bit integers.");
+
+PyDoc_STRVAR(xldt_dates__doc__,
+"dates(years, months=1, days=1, out=None)\n\n\
+Return the values of the dates made of the components like date(),\n\
+the months and the days out of their range being carried the same way.\n\
+The components can be numbers, objects exporting a buffer of numbers\n\
+(like array.array or numpy arrays of 16 or 32 bit integers or floats)\n\
+or sequences of numbers. A number is used with every item of the other\n\
+components. If all of them are numbers, the result is a float,\n\
+otherwise it is written in the writable buffer given as out or in a new\n\
+memoryview of floats.");
+
 PyDoc_STRVAR(xldt_day__doc__,
 "day(value: float) -> int\n\n\
 Return the day (1 - 31) of month of the date corresponding to the\n\
@@ -25,10 +63,77 @@ PyDoc_STRVAR(xldt_days__doc__,
 "days(start_date: float, end_date: float) -> int\n\n\
 Calculate the number of days between two dates.");
 
+PyDoc_STRVAR(xldt_decode__doc__,
+"decode(data, start=0, stop=None, out=None) -> memoryview\n\n\
+Decode the serial numbers from start (included) to stop (excluded) of\n\
+the data made by encode(), given as bytes or as any object exporting a\n\
+buffer, like a memory-mapped file. The bounds are adjusted like those\n\
+of a slice and only the blocks holding them are decoded. The result is\n\
+written in the writable buffer given as out or in a new memoryview of\n\
+64 bit integers, or of floats if the data has a time stream.");
+
+PyDoc_STRVAR(xldt_encode__doc__,
+"encode(values, resolution=0, block_size=4096, out=None) -> bytes | int\n\n\
+Encode the values (an object exporting a buffer of numbers or a sequence\n\
+of numbers) in a compact binary format. The days are stored as deltas\n\
+packed on the bits needed by each block of block_size values, sorted\n\
+dates taking a few bits each. If resolution is 0 the values are floored\n\
+to their days, otherwise the time of the day is kept as a number of\n\
+ticks, rounded to 1 / resolution of a day (86400 for seconds). Each\n\
+block can be decoded alone.\n\
+The data is returned as bytes, or written block after block in out and\n\
+its size returned. out is either a writable buffer (like a memory-mapped\n\
+file) which must be large enough, or a binary file whose write method\n\
+is called with each part, so that only one block is held in memory.");
+
+PyDoc_STRVAR(xldt_floor_to__doc__,
+"floor_to(value, unit, multiple=1, origin=None, week_start=SUN_1, out=None)\n\n\
+Return the start of the bucket containing the time given by the value.\n\
+The unit is one of the strings (in any case) 'second', 'minute',\n\
+'hour', 'day', 'week', 'month', 'quarter' or 'year' and a bucket spans\n\
+multiple units. The buckets are aligned on the origin if it's given,\n\
+otherwise on the serial 0 (on the 1st January of the year 0 for the\n\
+months, quarters and years). The weeks start on the first day of the\n\
+week type given as week_start (like SUN_1 or MON_1), the months on the\n\
+first day of a month, so that the origin only selects the week or the\n\
+month starting the first bucket. The bounds are computed on\n\
+milliseconds counted with integers, so that they never drift, and the\n\
+result never exceeds the value, even less than a millisecond before a\n\
+bound. The value can also be a buffer or a sequence of numbers, the result is then\n\
+written in the writable buffer given as out or in a new memoryview of\n\
+floats.");
+
+PyDoc_STRVAR(xldt_from_datetime__doc__,
+"from_datetime(value, out=None)\n\n\
+Return the value corresponding to the given datetime.date or\n\
+datetime.datetime object. An aware datetime is converted to UTC with its\n\
+utcoffset(), the value has no time zone. The value can also be an\n\
+iterable of dates, the results are then written in the writable\n\
+buffer given as out or in a new memoryview of floats.");
+
+PyDoc_STRVAR(xldt_from_isocalendar__doc__,
+"from_isocalendar(iso_year, iso_week=1, iso_weekday=1, out=None)\n\n\
+Return the value corresponding to the date given by its ISO year, ISO\n\
+week and ISO weekday (1 for Monday to 7 for Sunday). The weeks and the\n\
+weekdays out of range are carried over, like the months and the days of\n\
+date(). The arguments can also be buffers or sequences of numbers, the\n\
+results are then written in the writable buffer given as out or in a\n\
+new memoryview of floats.");
+
 PyDoc_STRVAR(xldt_hour__doc__,
 "hour(value: float) -> int\n\n\
 Return the hour (0 - 23) corresponding to the given value.");
 
+PyDoc_STRVAR(xldt_isocalendar__doc__,
+"isocalendar(value, out=None) -> tuple\n\n\
+Return the ISO year, the ISO week number and the ISO weekday (1 for\n\
+Monday to 7 for Sunday) of the date corresponding to the given value.\n\
+The ISO year differs from year() for the days of the first and the last\n\
+ISO week which belong to another year. The value can also be a buffer\n\
+or a sequence of numbers, the result is then a tuple of three columns\n\
+written in the sequence of writable buffers given as out or in new\n\
+memoryviews of 64 bit integers.");
+
 PyDoc_STRVAR(xldt_isweekend__doc__,
 "isweekend(value: float, result_type: int) -> bool\n\n\
 Return True if the date corresponding to the given value is a weekend.\n\
@@ -77,15 +182,62 @@ PyDoc_STRVAR(xldt_now__doc__,
 "now() -> float\n\n\
 Return the value corresponding to the current local date and time.");
 
+PyDoc_STRVAR(xldt_reset_stats__doc__,
+"reset_stats() -> None\n\n\
+Set to 0 all the counters returned by stats().");
+
+PyDoc_STRVAR(xldt_round_to__doc__,
+"round_to(value, unit, multiple=1, origin=None, week_start=SUN_1, out=None)\n\n\
+Return the start of the bucket nearest to the time given by the value,\n\
+the later one when the time is in the middle of a bucket.\n\
+The arguments are those of floor_to(), the value can also be a buffer\n\
+or a sequence of numbers.");
+
 PyDoc_STRVAR(xldt_second__doc__,
 "second(value: float) -> int\n\n\
 Return the second (0 - 59) corresponding to the given value.");
 
+PyDoc_STRVAR(xldt_stats__doc__,
+"stats() -> dict\n\n\
+Return the counters of the module functions, by function name. The\n\
+dictionary is empty unless the module was built with the XLDT_STATS\n\
+environment variable set. For each function, the counters are:\n\
+* calls - The number of calls\n\
+* converted - The calls whose first argument is a number but not a float\n\
+* slow - The calls taking a slow path (like a string weekend type)\n\
+* errors - The calls raising an exception\n\
+* rejected - The calls raising a TypeError for an invalid argument\n\
+* batches - The number of batches processed by a batch function\n\
+* items - The number of items processed by a batch function\n\
+* batch_sizes - The histogram of the batch sizes\n\
+* latency - The histogram of the sampled call durations, in ns\n\
+The item i of a histogram counts the values v with 2^i <= v < 2^(i+1).\n\
+The latency is sampled only when XLDT_STATS_LATENCY was also set.");
+
 PyDoc_STRVAR(xldt_time__doc__,
 "time(hour: float, minute: float, second: float) -> float\n\n\
 Return the value corresponding to the given time of the day. The \n\
 minute and the second are optional, defaulting to 0.");
 
+PyDoc_STRVAR(xldt_times__doc__,
+"times(hours, minutes=0, seconds=0, out=None)\n\n\
+Return the values of the times of the day made of the components like\n\
+time(), wrapped to a day the same way. The components and the result\n\
+are like those of dates().");
+
+PyDoc_STRVAR(xldt_to_date__doc__,
+"to_date(value)\n\n\
+Return the datetime.date corresponding to the given value. The value\n\
+can also be an iterable of values (like a list, an array.array or a\n\
+generator), the result is then a list of dates.");
+
+PyDoc_STRVAR(xldt_to_datetime__doc__,
+"to_datetime(value)\n\n\
+Return the datetime.datetime corresponding to the given value, with\n\
+the time rounded to the microsecond, which from_datetime() keeps. The\n\
+value can also be an iterable of values (like a list, an array.array\n\
+or a generator), the result is then a list of datetimes.");
+
 PyDoc_STRVAR(xldt_today__doc__,
 "today() -> int\n\n\
 Return the value corresponding to the current date (without time).");
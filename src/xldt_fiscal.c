@@ -0,0 +1,362 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "xldt_batch.h"
+#include "xldt_core.h"
+#include "xldt_fiscal.h"
+#include "xldt_msg.h"
+#include "xldt_stats.h"
+
+/*
+** The critical sections protect the cache of the fiscal years when the
+** module runs without the GIL. They don't exist before Python 3.13.
+*/
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+/*
+** The number of fiscal years whose bounds are cached by a calendar, a
+** power of 2. The year y is cached in the slot y % FISCAL_CACHE_SIZE.
+*/
+#define FISCAL_CACHE_SIZE 8
+
+typedef struct {
+    PyObject_HEAD
+    fiscal_calendar calendar;
+    /* The bounds of the recent fiscal years, a year of 0 if unused. */
+    fiscal_year cache[FISCAL_CACHE_SIZE];
+} FiscalCalendarObject;
+
+#define FISCAL_SLOT(year) ((unsigned long)(year) % FISCAL_CACHE_SIZE)
+
+#define FISCAL_CONTAINS(bounds, serial) \
+    ((bounds)->year != 0 && (serial) >= (bounds)->starts[0] && \
+     (serial) < (bounds)->starts[FISCAL_PERIODS])
+
+/*
+** The names of the patterns, in the order of the FISCAL_ values.
+*/
+static const char *const PATTERN_NAMES[] = {
+    "months", "4-4-5", "4-5-4", "5-4-4"
+};
+
+#define N_PATTERNS ((long)(sizeof(PATTERN_NAMES) / sizeof(PATTERN_NAMES[0])))
+
+static PyObject *
+FiscalCalendar_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"start_month", "pattern", "weekday",
+                               "anchor", NULL};
+    long a_start_month = 1, a_weekday = 6, pattern = FISCAL_MONTHS;
+    const char *a_pattern = NULL, *a_anchor = "last";
+    FiscalCalendarObject *self;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|lzls", keywords,
+                                     &a_start_month, &a_pattern,
+                                     &a_weekday, &a_anchor))
+    {
+        return NULL;
+    }
+    if (a_start_month < 1 || a_start_month > MONTHS_IN_YEAR) {
+        PyErr_Format(PyExc_ValueError, FISCAL_MONTH_ERRMSG, a_start_month);
+        return NULL;
+    }
+    if (a_pattern != NULL) {
+        while (pattern < N_PATTERNS &&
+               strcmp(a_pattern, PATTERN_NAMES[pattern]) != 0)
+        {
+            pattern += 1;
+        }
+        if (pattern == N_PATTERNS) {
+            PyErr_Format(PyExc_ValueError, FISCAL_PATTERN_ERRMSG, a_pattern);
+            return NULL;
+        }
+    }
+    if (a_weekday < 1 || a_weekday > DAYS_IN_WEEK) {
+        PyErr_Format(PyExc_ValueError, FISCAL_WEEKDAY_ERRMSG, a_weekday);
+        return NULL;
+    }
+    if (strcmp(a_anchor, "last") != 0 && strcmp(a_anchor, "nearest") != 0) {
+        PyErr_Format(PyExc_ValueError, FISCAL_ANCHOR_ERRMSG, a_anchor);
+        return NULL;
+    }
+    self = (FiscalCalendarObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        return NULL;
+    }
+    self->calendar.start_month = a_start_month;
+    self->calendar.pattern = pattern;
+    self->calendar.weekday = a_weekday;
+    self->calendar.nearest = a_anchor[0] == 'n';
+    return (PyObject *)self;
+}
+
+/*
+** Write the bounds of the fiscal year in the structure given as argument,
+** from the cache if they are there, computing and caching them otherwise.
+*/
+static void
+fiscal_cached_year(FiscalCalendarObject *self, long year,
+                   fiscal_year *bounds)
+{
+    fiscal_year *entry = &self->cache[FISCAL_SLOT(year)];
+    int found;
+    Py_BEGIN_CRITICAL_SECTION(self);
+    found = year != 0 && entry->year == year;
+    if (found) {
+        *bounds = *entry;
+    }
+    Py_END_CRITICAL_SECTION();
+    if (!found) {
+        fiscal_year_bounds(&self->calendar, year, bounds);
+        Py_BEGIN_CRITICAL_SECTION(self);
+        *entry = *bounds;
+        Py_END_CRITICAL_SECTION();
+    }
+}
+
+/*
+** Return the fiscal year of the serial number like 'serial_to_fiscal',
+** looking for its bounds in the cache when they aren't the ones given.
+*/
+static long
+fiscal_cached(FiscalCalendarObject *self, long serial, fiscal_year *bounds,
+              long *quarter, long *period, long *week)
+{
+    if (!FISCAL_CONTAINS(bounds, serial)) {
+        int i, found = 0;
+        Py_BEGIN_CRITICAL_SECTION(self);
+        for (i = 0; i < FISCAL_CACHE_SIZE; i++) {
+            if (FISCAL_CONTAINS(&self->cache[i], serial)) {
+                *bounds = self->cache[i];
+                found = 1;
+                break;
+            }
+        }
+        Py_END_CRITICAL_SECTION();
+        if (!found) {
+            long year = serial_to_fiscal(&self->calendar, serial, bounds,
+                                         quarter, period, week);
+            Py_BEGIN_CRITICAL_SECTION(self);
+            self->cache[FISCAL_SLOT(year)] = *bounds;
+            Py_END_CRITICAL_SECTION();
+            return year;
+        }
+    }
+    return serial_to_fiscal(&self->calendar, serial, bounds, quarter,
+                            period, week);
+}
+
+static PyObject *
+FiscalCalendar_fiscal(FiscalCalendarObject *self, PyObject *args,
+                      PyObject *kwargs)
+{
+    static char *keywords[] = {"value", "out", NULL};
+    PyObject *a_value, *a_out = Py_None;
+    batch_arg values;
+    batch_out outs[4];
+    fiscal_year bounds;
+    long year, quarter, period, week;
+    Py_ssize_t i;
+    int failed = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", keywords,
+                                     &a_value, &a_out))
+    {
+        return NULL;
+    }
+    if (batch_arg_init(&values, a_value, "value") < 0) {
+        return NULL;
+    }
+    bounds.year = 0;
+    if (values.kind == BATCH_SCALAR) {
+        if (batch_out_none(a_out) < 0) {
+            return NULL;
+        }
+        year = fiscal_cached(self, x_floor(values.scalar), &bounds,
+                             &quarter, &period, &week);
+        return Py_BuildValue("(llll)", year, quarter, period, week);
+    }
+    if (batch_outs_init(outs, 4, a_out, values.size, 'q') < 0) {
+        batch_arg_release(&values);
+        return NULL;
+    }
+    for (i = 0; i < values.size; i++) {
+        double v = batch_arg_item(&values, i);
+        if (v == -1.0 && PyErr_Occurred()) {
+            failed = 1;
+            break;
+        }
+        year = fiscal_cached(self, x_floor(v), &bounds, &quarter, &period,
+                             &week);
+        if (batch_out_set(&outs[0], i, year) < 0 ||
+            batch_out_set(&outs[1], i, quarter) < 0 ||
+            batch_out_set(&outs[2], i, period) < 0 ||
+            batch_out_set(&outs[3], i, week) < 0)
+        {
+            failed = 1;
+            break;
+        }
+    }
+    STATS_BATCH(STATS_FISCAL, values.size);
+    batch_arg_release(&values);
+    return batch_outs_finish(outs, 4, failed);
+}
+
+static PyObject *
+FiscalCalendar_periods(FiscalCalendarObject *self, PyObject *args)
+{
+    long a_year;
+    fiscal_year bounds;
+    PyObject *result;
+    int i;
+    if (!PyArg_ParseTuple(args, "l", &a_year)) {
+        return NULL;
+    }
+    fiscal_cached_year(self, a_year, &bounds);
+    result = PyTuple_New(FISCAL_PERIODS + 1);
+    for (i = 0; result != NULL && i <= FISCAL_PERIODS; i++) {
+        PyObject *start = PyLong_FromLong(bounds.starts[i]);
+        if (start == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyTuple_SET_ITEM(result, i, start);
+    }
+    return result;
+}
+
+static PyObject *
+FiscalCalendar_start_month(FiscalCalendarObject *self, void *closure)
+{
+    return PyLong_FromLong(self->calendar.start_month);
+}
+
+static PyObject *
+FiscalCalendar_pattern(FiscalCalendarObject *self, void *closure)
+{
+    if (self->calendar.pattern == FISCAL_MONTHS) {
+        Py_RETURN_NONE;
+    }
+    return PyUnicode_FromString(PATTERN_NAMES[self->calendar.pattern]);
+}
+
+static PyObject *
+FiscalCalendar_weekday(FiscalCalendarObject *self, void *closure)
+{
+    return PyLong_FromLong(self->calendar.weekday);
+}
+
+static PyObject *
+FiscalCalendar_anchor(FiscalCalendarObject *self, void *closure)
+{
+    return PyUnicode_FromString(self->calendar.nearest ? "nearest" : "last");
+}
+
+static PyObject *
+FiscalCalendar_repr(FiscalCalendarObject *self)
+{
+    if (self->calendar.pattern == FISCAL_MONTHS) {
+        return PyUnicode_FromFormat("FiscalCalendar(start_month=%ld)",
+                                    self->calendar.start_month);
+    }
+    return PyUnicode_FromFormat(
+        "FiscalCalendar(start_month=%ld, pattern='%s', weekday=%ld, "
+        "anchor='%s')", self->calendar.start_month,
+        PATTERN_NAMES[self->calendar.pattern], self->calendar.weekday,
+        self->calendar.nearest ? "nearest" : "last");
+}
+
+PyDoc_STRVAR(FiscalCalendar_fiscal__doc__,
+"fiscal(value, out=None) -> tuple\n\n\
+Return the fiscal year, the quarter (1 - 4), the period (1 - 12) and\n\
+the week (1 - 53) in the fiscal year of the date corresponding to the\n\
+given value. The value can also be a buffer or a sequence of numbers,\n\
+the result is then a tuple of four columns written in the sequence of\n\
+writable buffers given as out or in new memoryviews of 64 bit integers.\n\
+The period bounds are reused between consecutive values of the same\n\
+fiscal year, sorted values are the fastest, and the calendar keeps the\n\
+bounds of the last 8 fiscal years it met.");
+
+PyDoc_STRVAR(FiscalCalendar_periods__doc__,
+"periods(fiscal_year: int) -> tuple\n\n\
+Return the serial numbers of the first days of the 12 periods of the\n\
+fiscal year, followed by the first day of the next fiscal year.");
+
+STATS_WRAP_KW(FiscalCalendar_fiscal, STATS_FISCAL)
+
+static PyMethodDef FiscalCalendar_methods[] = {
+    {"fiscal",
+     (PyCFunction)(void (*)(void))STATS_METHOD(FiscalCalendar_fiscal),
+     METH_VARARGS | METH_KEYWORDS, FiscalCalendar_fiscal__doc__},
+    {"periods", (PyCFunction)FiscalCalendar_periods, METH_VARARGS,
+     FiscalCalendar_periods__doc__},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef FiscalCalendar_getset[] = {
+    {"start_month", (getter)FiscalCalendar_start_month, NULL,
+     "The month (1 - 12) starting the fiscal year.", NULL},
+    {"pattern", (getter)FiscalCalendar_pattern, NULL,
+     "The pattern of the periods, None for calendar months.", NULL},
+    {"weekday", (getter)FiscalCalendar_weekday, NULL,
+     "The weekday (1 for Monday to 7 for Sunday) ending the fiscal year.",
+     NULL},
+    {"anchor", (getter)FiscalCalendar_anchor, NULL,
+     "How the weekday ending the fiscal year is chosen.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+PyDoc_STRVAR(FiscalCalendar__doc__,
+"FiscalCalendar(start_month=1, pattern=None, weekday=6, anchor='last')\n\n\
+A fiscal calendar whose fiscal year starts with the start_month and is\n\
+numbered with the calendar year in which it ends.\n\
+If pattern is None, the periods are the calendar months. Otherwise it\n\
+is one of the strings '4-4-5', '4-5-4' or '5-4-4' giving the number of\n\
+weeks of the three periods of every quarter of a 52 or 53 week fiscal\n\
+year. Such a fiscal year ends on the weekday (1 for Monday to 7 for\n\
+Sunday, like weekday(value, MON_1)) which is the last one of the month\n\
+before the start_month if anchor is 'last', or the nearest to the end\n\
+of that month if anchor is 'nearest'. The 53rd week, if any, belongs\n\
+to the last period.");
+
+PyTypeObject FiscalCalendar_Type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "xldt.FiscalCalendar",              /* tp_name */
+    sizeof(FiscalCalendarObject),       /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    0,                                  /* tp_dealloc */
+    0,                                  /* tp_vectorcall_offset */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_as_async */
+    (reprfunc)FiscalCalendar_repr,      /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    FiscalCalendar__doc__,              /* tp_doc */
+    0,                                  /* tp_traverse */
+    0,                                  /* tp_clear */
+    0,                                  /* tp_richcompare */
+    0,                                  /* tp_weaklistoffset */
+    0,                                  /* tp_iter */
+    0,                                  /* tp_iternext */
+    FiscalCalendar_methods,             /* tp_methods */
+    0,                                  /* tp_members */
+    FiscalCalendar_getset,              /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    FiscalCalendar_new,                 /* tp_new */
+};
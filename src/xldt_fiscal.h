@@ -0,0 +1,14 @@
+#ifndef __XLDT_FISCAL_H__
+#define __XLDT_FISCAL_H__
+
+#ifndef Py_PYTHON_H
+#error The Python header must be included before this header.
+#endif
+
+/*
+** The FiscalCalendar type, mapping serial numbers to fiscal years,
+** quarters, periods and weeks.
+*/
+extern PyTypeObject FiscalCalendar_Type;
+
+#endif
@@ -9,4 +9,82 @@
 
 #define WEEKEND_TYPE_ERRMSG "weekend(): invalid result type %R"
 
+#define BATCH_FORMAT_ERRMSG "%s: unsupported buffer format"
+
+#define BATCH_SHAPE_ERRMSG "%s: expected a one-dimensional buffer"
+
+#define BATCH_SIZE_ERRMSG "arguments of different sizes (%zd and %zd)"
+
+#define BATCH_OUT_FORMAT_ERRMSG "out: unsupported buffer format"
+
+#define BATCH_OUT_SHAPE_ERRMSG "out: expected a one-dimensional buffer"
+
+#define BATCH_OUT_SIZE_ERRMSG "out: expected %zd items, got %zd"
+
+#define BATCH_OUTS_ERRMSG "out: expected a sequence of %zd buffers"
+
+#define BATCH_OUT_RANGE_ERRMSG \
+    "out: the result at index %zd doesn't fit in the item format '%c'"
+
+#define BATCH_OUT_SCALAR_ERRMSG \
+    "out: not allowed when the result isn't a batch"
+
+#define BATCH_CHANGED_ERRMSG "the sequence changed size during the call"
+
+#define BATCH_LONG_RANGE_ERRMSG \
+    "the item at index %zd doesn't fit in a C long"
+
+#define DATETIME_RANGE_ERRMSG "serial %ld is out of the range of datetime"
+
+#define DATETIME_TYPE_ERRMSG "from_datetime(): expected a date, got %R"
+
+#define DATEDIF_UNIT_ERRMSG "datedif(): invalid unit %R"
+
+#define DATEDIF_UNITS_ERRMSG "datedif(): invalid units"
+
+#define SERIAL_ARRAY_FORMAT_ERRMSG \
+    "SerialArray(): expected a buffer of 32 bit integers or of floats"
+
+#define SERIAL_ARRAY_RANGE_ERRMSG \
+    "SerialArray: the year of serial %ld doesn't fit on 16 bits"
+
+#define SERIAL_ARRAY_INDEX_ERRMSG "SerialArray: index out of range"
+
+#define SERIAL_ARRAY_STEP_ERRMSG "SerialArray: slice step must be 1"
+
+#define SERIAL_ARRAY_KEY_ERRMSG "SerialArray: invalid index %R"
+
+#define SERIAL_ARRAY_WRITE_ERRMSG "SerialArray: the buffer is read-only"
+
+#define FISCAL_MONTH_ERRMSG "FiscalCalendar(): invalid start month %ld"
+
+#define FISCAL_PATTERN_ERRMSG "FiscalCalendar(): invalid pattern '%s'"
+
+#define FISCAL_WEEKDAY_ERRMSG "FiscalCalendar(): invalid weekday %ld"
+
+#define FISCAL_ANCHOR_ERRMSG "FiscalCalendar(): invalid anchor '%s'"
+
+#define CODEC_VALUES_ERRMSG "encode(): expected a buffer or a sequence"
+
+#define CODEC_VALUE_ERRMSG "encode(): can't encode the value at index %zd"
+
+#define CODEC_RESOLUTION_ERRMSG "encode(): invalid resolution %llu"
+
+#define CODEC_BLOCK_SIZE_ERRMSG "encode(): invalid block size %llu"
+
+#define CODEC_DATA_ERRMSG "decode(): invalid or corrupted data"
+
+#define CODEC_OUT_ERRMSG \
+    "encode(): out must be a writable buffer or have a write method"
+
+#define CODEC_OUT_SIZE_ERRMSG "encode(): the data doesn't fit in %zd bytes"
+
+#define BUCKET_UNIT_ERRMSG "%s(): invalid unit %R"
+
+#define BUCKET_MULTIPLE_ERRMSG "%s(): invalid multiple %ld"
+
+#define BUCKET_WEEK_ERRMSG "%s(): invalid week start %ld"
+
+#define BUCKET_VALUE_ERRMSG "%s(): value out of range"
+
 #endif
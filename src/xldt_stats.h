@@ -0,0 +1,260 @@
+#ifndef __XLDT_STATS_H__
+#define __XLDT_STATS_H__
+
+#ifndef Py_PYTHON_H
+#error The Python header must be included before this header.
+#endif
+
+/*
+** Optional instrumentation of the exported functions. It is compiled only
+** when the XLDT_STATS macro is defined (setup.py defines it when the
+** XLDT_STATS environment variable is set), otherwise the macros below
+** expand to nothing and the functions are called directly.
+** For each function the module counts the calls, the calls whose first
+** argument is a number which isn't a float (it must be converted), the
+** calls taking a slow path, the calls failing with an exception, the calls
+** rejecting an argument of an invalid type and, for the batch functions,
+** the number of batches and of items, with a log2 histogram of the batch
+** sizes. When XLDT_STATS_LATENCY is also defined, one call out of
+** STATS_SAMPLE is timed and the duration is added to a log2 histogram of
+** nanoseconds.
+*/
+
+enum {
+    STATS_CEIL_TO,
+    STATS_DATE,
+    STATS_DATEDIF,
+    STATS_DATES,
+    STATS_DAY,
+    STATS_DAYS,
+    STATS_DECODE,
+    STATS_ENCODE,
+    STATS_FISCAL,
+    STATS_FLOOR_TO,
+    STATS_FROM_DATETIME,
+    STATS_FROM_ISOCALENDAR,
+    STATS_HOUR,
+    STATS_ISOCALENDAR,
+    STATS_ISWEEKEND,
+    STATS_ISOWEEK,
+    STATS_MINUTE,
+    STATS_MONTH,
+    STATS_MONTHS,
+    STATS_NOW,
+    STATS_ROUND_TO,
+    STATS_SECOND,
+    STATS_TIME,
+    STATS_TIMES,
+    STATS_TO_DATE,
+    STATS_TO_DATETIME,
+    STATS_TODAY,
+    STATS_WEEKDAY,
+    STATS_WEEK,
+    STATS_YEAR,
+    STATS_YEARS,
+    STATS_FUNCTIONS
+};
+
+#ifdef XLDT_STATS_LATENCY
+#ifndef XLDT_STATS
+#define XLDT_STATS
+#endif
+#endif
+
+#ifdef XLDT_STATS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/*
+** The histogram bucket i counts the values v with 2^i <= v < 2^(i + 1),
+** the bucket 0 also counts the value 0.
+*/
+#define STATS_BUCKETS 32
+
+#ifndef STATS_SAMPLE
+#define STATS_SAMPLE 16
+#endif
+
+typedef struct {
+    unsigned long long calls;
+    unsigned long long converted;
+    unsigned long long slow;
+    unsigned long long errors;
+    unsigned long long rejected;
+    unsigned long long batches;
+    unsigned long long items;
+    unsigned long long batch_sizes[STATS_BUCKETS];
+    unsigned long long latency[STATS_BUCKETS];
+} stats_entry;
+
+/*
+** The counters are updated with relaxed atomic operations, so that they
+** stay exact when the module runs without the GIL.
+*/
+#ifdef _MSC_VER
+#define STATS_ADD(p, n) \
+    ((unsigned long long)_InterlockedExchangeAdd64((volatile __int64 *)(p), \
+                                                   (__int64)(n)))
+#define STATS_LOAD(p) \
+    ((unsigned long long)_InterlockedOr64((volatile __int64 *)(p), 0))
+#define STATS_CLEAR(p) _InterlockedExchange64((volatile __int64 *)(p), 0)
+#else
+#define STATS_ADD(p, n) __atomic_fetch_add((p), (n), __ATOMIC_RELAXED)
+#define STATS_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STATS_CLEAR(p) __atomic_store_n((p), 0, __ATOMIC_RELAXED)
+#endif
+
+/*
+** The counters of the functions, defined in xldt.c and shared with the
+** methods of the types defined in the other files.
+*/
+extern stats_entry stats_table[STATS_FUNCTIONS];
+
+static int
+stats_bucket(unsigned long long v)
+{
+    int i = 0;
+    while (v > 1 && i < STATS_BUCKETS - 1) {
+        v >>= 1;
+        i += 1;
+    }
+    return i;
+}
+
+#ifdef XLDT_STATS_LATENCY
+/*
+** Return a monotonic time in nanoseconds.
+*/
+static unsigned long long
+stats_clock(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (unsigned long long)((double)count.QuadPart * 1e9 /
+                                (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+#endif
+
+/*
+** Call the function, updating the counters of the given entry. The
+** function takes keyword arguments when keywords is true.
+*/
+static PyObject *
+stats_invoke(PyCFunction function, int keywords, PyObject *self,
+             PyObject *args, PyObject *kwargs)
+{
+    if (keywords) {
+        return ((PyCFunctionWithKeywords)(void (*)(void))function)(
+            self, args, kwargs);
+    }
+    return function(self, args);
+}
+
+/*
+** Return true if the argument is a scalar which isn't a float, converted
+** with PyNumber_Float. The buffers and the sequences of the batch
+** functions aren't converted as a whole.
+*/
+static int
+stats_converted(PyObject *arg)
+{
+    return !PyFloat_CheckExact(arg) && !PyObject_CheckBuffer(arg) &&
+           !PyList_Check(arg) && !PyTuple_Check(arg) && PyNumber_Check(arg);
+}
+
+static PyObject *
+stats_call(int index, PyCFunction function, int keywords, PyObject *self,
+           PyObject *args, PyObject *kwargs)
+{
+    stats_entry *entry = &stats_table[index];
+    unsigned long long calls = STATS_ADD(&entry->calls, 1);
+    PyObject *result;
+    if (args != NULL && PyTuple_GET_SIZE(args) > 0 &&
+        stats_converted(PyTuple_GET_ITEM(args, 0)))
+    {
+        STATS_ADD(&entry->converted, 1);
+    }
+#ifdef XLDT_STATS_LATENCY
+    if (calls % STATS_SAMPLE == 0) {
+        unsigned long long start = stats_clock();
+        result = stats_invoke(function, keywords, self, args, kwargs);
+        STATS_ADD(&entry->latency[stats_bucket(stats_clock() - start)], 1);
+    }
+    else {
+        result = stats_invoke(function, keywords, self, args, kwargs);
+    }
+#else
+    (void)calls;
+    result = stats_invoke(function, keywords, self, args, kwargs);
+#endif
+    if (result == NULL) {
+        STATS_ADD(&entry->errors, 1);
+        if (PyErr_ExceptionMatches(PyExc_TypeError)) {
+            STATS_ADD(&entry->rejected, 1);
+        }
+    }
+    return result;
+}
+
+/*
+** Define a wrapper named function_stats calling the function through
+** 'stats_call'. STATS_METHOD selects the wrapper in the method table.
+** STATS_WRAP_KW is used for the functions taking keyword arguments.
+*/
+#define STATS_WRAP(function, index) \
+    static PyObject * \
+    function##_stats(PyObject *self, PyObject *args) \
+    { \
+        return stats_call((index), (function), 0, self, args, NULL); \
+    }
+
+#define STATS_WRAP_KW(function, index) \
+    static PyObject * \
+    function##_stats(PyObject *self, PyObject *args, PyObject *kwargs) \
+    { \
+        return stats_call((index), \
+                          (PyCFunction)(void (*)(void))(function), 1, \
+                          self, args, kwargs); \
+    }
+
+#define STATS_METHOD(function) function##_stats
+
+/*
+** Count a call of the function taking a slow path.
+*/
+#define STATS_SLOW(index) STATS_ADD(&stats_table[(index)].slow, 1)
+
+/*
+** Count a batch of n items processed by the function.
+*/
+#define STATS_BATCH(index, n) \
+    do { \
+        unsigned long long n_items_ = (unsigned long long)(n); \
+        STATS_ADD(&stats_table[(index)].batches, 1); \
+        STATS_ADD(&stats_table[(index)].items, n_items_); \
+        STATS_ADD(&stats_table[(index)].batch_sizes[ \
+            stats_bucket(n_items_)], 1); \
+    } while (0)
+
+#else
+
+#define STATS_WRAP(function, index)
+#define STATS_WRAP_KW(function, index)
+#define STATS_METHOD(function) function
+#define STATS_SLOW(index) ((void)0)
+#define STATS_BATCH(index, n) ((void)0)
+
+#endif
+
+#endif
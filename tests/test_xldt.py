@@ -1,5 +1,11 @@
+import array
 import csv
+import ctypes
+import datetime
+import mmap
 import os
+import tempfile
+import threading
 import unittest
 import xldt
 
@@ -75,5 +81,412 @@ class TestDateValue(unittest.TestCase):
                                                xldt.date(y2, m2, d2)),
                     'error at {:04d}-{:02d}-{:02d}'.format(y1, m1, d1))
 
+    def test_datedif(self):
+        starts, ends, expected = array.array('d'), array.array('d'), []
+        with open(os.path.join(ROOT, 'data/delta.csv'), newline='') as src:
+            reader = csv.DictReader(src, delimiter=';')
+            for r in reader:
+                y1, m1, d1 = map(int, r['START_DATE'].split('-'))
+                y2, m2, d2 = map(int, r['END_DATE'].split('-'))
+                starts.append(xldt.date(y1, m1, d1))
+                ends.append(xldt.date(y2, m2, d2))
+                expected.append((int(r['DAYS']), int(r['MONTHS']),
+                                 int(r['YEARS'])))
+        days, months, years = xldt.datedif(starts, ends, ('D', 'M', 'Y'))
+        self.assertEqual(expected, list(zip(days.tolist(), months.tolist(),
+                                            years.tolist())))
+        md, ym, yd = xldt.datedif(starts, ends, ['md', 'ym', 'yd'])
+        for i in range(len(starts)):
+            s, e = starts[i], ends[i]
+            self.assertEqual(ym[i], months[i] - 12 * years[i])
+            self.assertEqual(md[i], xldt.datedif(s, e, 'MD'))
+            self.assertEqual(yd[i], xldt.datedif(s, e, 'YD'))
+        # Excel's result when the day of the end is lesser than the day of
+        # the start and the month before the end is too short.
+        s, e = xldt.date(2011, 1, 31), xldt.date(2011, 3, 1)
+        self.assertEqual(-2, xldt.datedif(s, e, 'MD'))
+        self.assertEqual(29, xldt.datedif(s, e, 'YD'))
+        out = array.array('l', [0] * len(starts))
+        self.assertIs(out, xldt.datedif(starts, ends[0], 'D', out=out))
+        self.assertEqual([ends[0] - v for v in starts], out.tolist())
+        with self.assertRaises(ValueError):
+            xldt.datedif(starts, [1, 2], 'D')
+        with self.assertRaises(ValueError):
+            xldt.datedif(starts, ends, 'W')
+        with self.assertRaises(OverflowError):
+            xldt.datedif(array.array('d', [1, 2]), 40000, 'D',
+                         out=array.array('b', [0, 0]))
+        with self.assertRaises(TypeError):
+            xldt.datedif(1, 40000, 'D', out=array.array('l', [0]))
+        # A 0-d buffer is a scalar, a buffer of more dimensions an error.
+        scalar = memoryview(array.array('d', [1])).cast('B').cast('d', [])
+        self.assertEqual(39999, xldt.datedif(scalar, 40000, 'D'))
+        self.assertEqual(xldt.to_date(1), xldt.to_date(scalar))
+        table = memoryview(array.array('d', [1, 2])).cast('B').cast('d', [1, 2])
+        with self.assertRaises(TypeError):
+            xldt.datedif(table, 40000, 'D')
+        with self.assertRaises(TypeError):
+            xldt.datedif(starts[:2], 40000, 'D',
+                         out=memoryview(array.array('l', [0, 0])).cast(
+                             'B').cast('l', [1, 2]))
+
+    def test_isocalendar(self):
+        values = range(-600000, 2900000, 13)
+        years, weeks, weekdays = xldt.isocalendar(values)
+        for i, n in enumerate(values):
+            expected = tuple(xldt.to_date(n).isocalendar())
+            self.assertEqual(expected, xldt.isocalendar(n))
+            self.assertEqual(expected, (years[i], weeks[i], weekdays[i]))
+            self.assertEqual(n, xldt.from_isocalendar(*expected))
+        serials = xldt.from_isocalendar(years, weeks, weekdays)
+        self.assertEqual(list(values), serials.tolist())
+        # 2021-01-03 belongs to the last ISO week of 2020.
+        self.assertEqual((2020, 53, 7),
+                         xldt.isocalendar(xldt.date(2021, 1, 3)))
+        self.assertEqual(xldt.date(2021, 1, 4),
+                         xldt.from_isocalendar(2020, 53, 8))
+        # The omitted week and weekday are the first ones.
+        self.assertEqual([xldt.date(2019, 12, 30), xldt.date(2021, 1, 4)],
+                         xldt.from_isocalendar([2020, 2021]).tolist())
+        self.assertEqual([xldt.date(2020, 1, 6)],
+                         xldt.from_isocalendar([2020], [2]).tolist())
+
+    def test_fiscal_months(self):
+        values = range(30000, 50000, 3)
+        for start in range(1, 13):
+            calendar = xldt.FiscalCalendar(start)
+            years, quarters, periods, weeks = calendar.fiscal(values)
+            for i, n in enumerate(values):
+                y, m = xldt.year(n), xldt.month(n)
+                period = (m - start) % 12 + 1
+                expected = (y + (start > 1 and m >= start),
+                            (period - 1) // 3 + 1, period)
+                self.assertEqual(expected, calendar.fiscal(n)[:3])
+                self.assertEqual(expected, (years[i], quarters[i],
+                                            periods[i]))
+                first = calendar.periods(years[i])[0]
+                self.assertEqual((n - first) // 7 + 1, weeks[i])
+
+    def test_fiscal_weeks(self):
+        values = range(30000, 50000)
+        for pattern, lengths in (('4-4-5', (4, 4, 5)), ('4-5-4', (4, 5, 4)),
+                                 ('5-4-4', (5, 4, 4))):
+            for anchor in ('last', 'nearest'):
+                calendar = xldt.FiscalCalendar(2, pattern, 6, anchor)
+                years, quarters, periods, weeks = calendar.fiscal(values)
+                for i, n in enumerate(values):
+                    bounds = calendar.periods(years[i])
+                    p = periods[i]
+                    self.assertTrue(bounds[p - 1] <= n < bounds[p])
+                    self.assertEqual((p - 1) // 3 + 1, quarters[i])
+                    self.assertEqual((n - bounds[0]) // 7 + 1, weeks[i])
+                    self.assertEqual(xldt.weekday(bounds[12] - 1, xldt.MON_1),
+                                     6)
+                    self.assertIn(bounds[12] - bounds[0], (364, 371))
+                    size = (bounds[p] - bounds[p - 1]) // 7
+                    if p < 12 or bounds[12] - bounds[0] == 364:
+                        self.assertEqual(lengths[(p - 1) % 3], size)
+                    end = xldt.date(years[i], 2, 0)
+                    if anchor == 'last':
+                        self.assertTrue(0 <= end - (bounds[12] - 1) < 7)
+                    else:
+                        self.assertTrue(abs(end - (bounds[12] - 1)) <= 3)
+        # The bounds cached by a calendar give the results of a new one.
+        calendar = xldt.FiscalCalendar(7, '4-5-4')
+        values = list(range(44000, 40000, -37)) + list(range(40000, 44000, 53))
+        columns = calendar.fiscal(values)
+        for i, n in enumerate(values):
+            expected = xldt.FiscalCalendar(7, '4-5-4').fiscal(n)
+            self.assertEqual(expected, calendar.fiscal(n))
+            self.assertEqual(expected, tuple(c[i] for c in columns))
+            self.assertEqual(xldt.FiscalCalendar(7, '4-5-4').periods(
+                expected[0]), calendar.periods(expected[0]))
+        with self.assertRaises(ValueError):
+            xldt.FiscalCalendar(13)
+        with self.assertRaises(ValueError):
+            xldt.FiscalCalendar(1, '4-4-4')
+
+    def test_datetime(self):
+        values = [n / 7 for n in range(-600000, 2900000, 997)]
+        dates = xldt.to_date(values)
+        datetimes = xldt.to_datetime(v for v in values)
+        serials = xldt.from_datetime(dates)
+        for i, v in enumerate(values):
+            d, t = dates[i], datetimes[i]
+            self.assertEqual((xldt.year(v), xldt.month(v), xldt.day(v)),
+                             (d.year, d.month, d.day))
+            self.assertEqual(d, xldt.to_date(v))
+            self.assertEqual(t, xldt.to_datetime(v))
+            self.assertEqual(datetime.datetime.combine(d, datetime.time()) +
+                             datetime.timedelta(
+                                 microseconds=round(v % 1 * 864e8)), t)
+            self.assertEqual(int(v // 1), serials[i])
+            self.assertAlmostEqual(v, xldt.from_datetime(t),
+                                   delta=0.5 / 864e8 + abs(v) * 2 ** -50)
+        # The microseconds survive the round trips, for dates which are
+        # precise enough.
+        start = datetime.datetime(1900, 1, 1)
+        for n in range(0, 170 * 365 * 86400 * 10 ** 6, 9876543210123):
+            t = start + datetime.timedelta(microseconds=n)
+            self.assertEqual(t, xldt.to_datetime(xldt.from_datetime(t)))
+        self.assertEqual(datetime.date(2023, 3, 15),
+                         xldt.to_date(45000.99999999))
+        self.assertEqual(datetime.datetime(2023, 3, 15, 23, 59, 59, 999999),
+                         xldt.to_datetime(45000.99999999999))
+        self.assertEqual(datetime.datetime(2023, 3, 16),
+                         xldt.to_datetime(45000.999999999999))
+        # Aware datetimes are converted to UTC.
+        t = datetime.datetime(2023, 3, 15, 12, 30)
+        tz = datetime.timezone(datetime.timedelta(hours=-5, minutes=-30))
+        self.assertEqual(xldt.from_datetime(t + datetime.timedelta(
+            hours=5, minutes=30)), xldt.from_datetime(t.replace(tzinfo=tz)))
+        self.assertEqual(xldt.from_datetime([t]).tolist(), xldt.from_datetime(
+            [t.replace(tzinfo=datetime.timezone.utc)]).tolist())
+        with self.assertRaises(OverflowError):
+            xldt.to_date(1e7)
+        with self.assertRaises(TypeError):
+            xldt.from_datetime([1.0])
+
+    def test_serial_array(self):
+        values = array.array('d', [n + 0.25 for n in range(-1000, 60000, 7)])
+        serials = xldt.SerialArray(values)
+        self.assertEqual(len(values), len(serials))
+        self.assertEqual(values.tolist(), memoryview(serials).tolist())
+        part = serials[100:200]
+        self.assertEqual(values[100:200].tolist(), list(part))
+        for a, v in ((serials, values), (part, values[100:200]),
+                     (part[10:], values[110:200])):
+            self.assertEqual([xldt.year(n) for n in v], a.year.tolist())
+            self.assertEqual([xldt.month(n) for n in v], a.month.tolist())
+            self.assertEqual([xldt.day(n) for n in v], a.day.tolist())
+            self.assertEqual([xldt.weekday(n) for n in v],
+                             a.weekday.tolist())
+            self.assertEqual([xldt.isoweek(n) for n in v],
+                             a.isoweek.tolist())
+        self.assertEqual('h', serials.year.format)
+        self.assertEqual('b', serials.day.format)
+        days = xldt.SerialArray(array.array('i', range(1, 400)))
+        self.assertEqual([xldt.day(n) for n in range(1, 400)],
+                         days.day.tolist())
+        with self.assertRaises(TypeError):
+            xldt.SerialArray(array.array('b', [1]))
+        with self.assertRaises(ValueError):
+            serials[::2]
+
+    def test_codec(self):
+        days = array.array('i', range(40000, 50000))
+        data = xldt.encode(days, block_size=1000)
+        self.assertLess(len(data), len(days))
+        self.assertEqual(days.tolist(), xldt.decode(data).tolist())
+        self.assertEqual(days[2500:4200].tolist(),
+                         xldt.decode(data, 2500, 4200).tolist())
+        self.assertEqual(days[-10:].tolist(), xldt.decode(data, -10).tolist())
+        values = [(n * 7919) % 60000 - 1000 + (n % 86400) / 86400
+                  for n in range(5000)]
+        data = xldt.encode(values, resolution=86400, block_size=300)
+        self.assertEqual(values, xldt.decode(data).tolist())
+        self.assertEqual(values[299:301], xldt.decode(data, 299, 301).tolist())
+        self.assertEqual([int(v // 1) for v in values],
+                         xldt.decode(xldt.encode(values)).tolist())
+        out = array.array('d', bytes(8 * 10))
+        xldt.decode(data, 10, 20, out=out)
+        self.assertEqual(values[10:20], out.tolist())
+        self.assertEqual([], xldt.decode(xldt.encode([])).tolist())
+        with self.assertRaises(ValueError):
+            xldt.decode(data[:len(data) // 2])
+        with self.assertRaises(ValueError):
+            xldt.encode([float('inf')])
+        # Consecutive days take no bits, only the block headers and index.
+        data = xldt.encode(days, block_size=1000)
+        self.assertLess(len(data), 200)
+        # The data can be written in a buffer or a file, block by block.
+        out = bytearray(len(data) + 10)
+        self.assertEqual(len(data), xldt.encode(days, block_size=1000,
+                                                out=out))
+        self.assertEqual(data, out[:len(data)])
+        with tempfile.TemporaryFile() as f:
+            self.assertEqual(len(data), xldt.encode(days, block_size=1000,
+                                                    out=f))
+            f.flush()
+            with mmap.mmap(f.fileno(), 0) as m:
+                self.assertEqual(days[990:1010].tolist(),
+                                 xldt.decode(m, 990, 1010).tolist())
+        with self.assertRaises(ValueError):
+            xldt.encode(days, block_size=1000,
+                        out=bytearray(len(data) - 1))
+        with self.assertRaises(TypeError):
+            xldt.encode(days, out=1)
+
+    def test_bucket(self):
+        start = xldt.date(2023, 3, 15)
+        values = [start + n / 1440 for n in range(0, 3000, 7)]
+        for v in values:
+            minutes = round((v - start) * 1440)
+            floor = start + minutes // 15 * 15 / 1440
+            self.assertEqual(floor, xldt.floor_to(v, 'minute', 15))
+            ceil = start + -(-minutes // 15) * 15 / 1440
+            self.assertEqual(ceil, xldt.ceil_to(v, 'minute', 15))
+        self.assertEqual(
+            [xldt.floor_to(v, 'Hour') for v in values],
+            xldt.floor_to(array.array('d', values), 'hour').tolist())
+        self.assertEqual(start + 0.5, xldt.round_to(start + 0.52, 'hour', 6))
+        self.assertEqual(start + 1, xldt.round_to(start + 0.5, 'day'))
+        self.assertEqual(start + 5 / 24,
+                         xldt.floor_to(start + 0.3, 'hour', 8, start - 1 / 8))
+        monday = xldt.floor_to(start, 'week', week_start=xldt.MON_1)
+        self.assertEqual(1, xldt.weekday(monday, xldt.MON_1))
+        self.assertEqual(monday - 1, xldt.floor_to(start, 'week'))
+        self.assertEqual(xldt.date(2023, 1, 1),
+                         xldt.floor_to(start + 0.5, 'quarter'))
+        self.assertEqual(xldt.date(2023, 4, 1), xldt.ceil_to(start, 'quarter'))
+        self.assertEqual(xldt.date(2023, 4, 1),
+                         xldt.round_to(start + 2, 'month'))
+        self.assertEqual(xldt.date(2023, 2, 1),
+                         xldt.floor_to(start, 'year', 1,
+                                       xldt.date(2000, 2, 10)))
+        march = xldt.date(2023, 3, 1)
+        self.assertEqual(march, xldt.ceil_to(march, 'year', 5, start))
+        # The values less than half a tick away from a bucket bound.
+        self.assertEqual(45000, xldt.floor_to(45000.9999999999, 'day'))
+        self.assertEqual(45001, xldt.ceil_to(45000.0000000001, 'day'))
+        self.assertEqual(45000, xldt.round_to(45000.4999999999, 'day'))
+        tick = 1 / 86400000
+        for bound in (45000, 45000 + 1 / 24, xldt.date(2023, 4, 1)):
+            for delta in (-0.4 * tick, -1e-10, 0, 1e-10, 0.4 * tick):
+                v = bound + delta
+                for unit in ('second', 'hour', 'day', 'month'):
+                    self.assertLessEqual(xldt.floor_to(v, unit), v)
+                    self.assertGreaterEqual(xldt.ceil_to(v, unit), v)
+        with self.assertRaises(ValueError):
+            xldt.floor_to(start, 'fortnight')
+        with self.assertRaises(ValueError):
+            xldt.floor_to(start, 'day', 0)
+
+    def test_components(self):
+        years = array.array('h', [1900 + n % 200 for n in range(1000)])
+        months = array.array('i', [n % 40 - 13 for n in range(1000)])
+        days = [(n * 37) % 500 - 100 + 0.5 for n in range(1000)]
+        self.assertEqual(
+            [xldt.date(y, m, d) for y, m, d in zip(years, months, days)],
+            xldt.dates(years, months, days).tolist())
+        self.assertEqual([xldt.date(y, 2, 30) for y in years],
+                         xldt.dates(years, 2, 30).tolist())
+        self.assertEqual(xldt.date(2023, 14, -3), xldt.dates(2023, 14, -3))
+        self.assertEqual(
+            [xldt.date(2023, m, int(d)) for m, d in zip(months, days)],
+            xldt.dates(2023, list(months), array.array('l', map(int, days)))
+            .tolist())
+        with self.assertRaises(OverflowError):
+            xldt.dates([2000, 2 ** 70], 1, 1)
+        with self.assertRaises(OverflowError):
+            xldt.dates([2000.0, 1e30], 1, 1)
+        hours = array.array('d', [n / 7 - 50 for n in range(1000)])
+        self.assertEqual(
+            [xldt.time(h, m, 30) for h, m in zip(hours, months)],
+            xldt.times(hours, months, 30).tolist())
+        out = array.array('d', bytes(8 * 3))
+        xldt.times([1, 25, -1], out=out)
+        self.assertEqual([xldt.time(1), xldt.time(25), xldt.time(-1)],
+                         out.tolist())
+        with self.assertRaises(ValueError):
+            xldt.dates([2000, 2001], [1, 2, 3])
+
+    def test_threads(self):
+        expected = [(xldt.year(n), xldt.isoweek(n)) for n in range(50000)]
+        errors = []
+        def work():
+            for n in range(50000):
+                if (xldt.year(n), xldt.isoweek(n)) != expected[n]:
+                    errors.append(n)
+                    break
+        threads = [threading.Thread(target=work) for _ in range(8)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual([], errors)
+
+    def test_capi(self):
+        get_pointer = ctypes.pythonapi.PyCapsule_GetPointer
+        get_pointer.restype = ctypes.c_void_p
+        get_pointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+        p_long = ctypes.POINTER(ctypes.c_long)
+        class Fields(ctypes.Structure):
+            _fields_ = [(name, ctypes.c_long)
+                        for name in ('serial', 'year', 'month', 'day')]
+        class CAPI(ctypes.Structure):
+            _fields_ = [
+                ('version', ctypes.c_int),
+                ('serial_to_date', ctypes.CFUNCTYPE(None, ctypes.c_long,
+                    p_long, p_long, p_long)),
+                ('date_as_serial', ctypes.CFUNCTYPE(ctypes.c_long,
+                    ctypes.c_long, ctypes.c_long, ctypes.c_long)),
+                ('serial_as_weekday', ctypes.CFUNCTYPE(ctypes.c_long,
+                    ctypes.c_long, ctypes.c_long)),
+                ('serial_as_week', ctypes.CFUNCTYPE(ctypes.c_long,
+                    ctypes.c_long, ctypes.c_long)),
+                ('serial_to_fields', ctypes.c_void_p),
+                ('fields_difference', ctypes.c_void_p),
+                ('fields_as_isoweek', ctypes.c_void_p),
+                ('isocalendar_as_serial', ctypes.c_void_p),
+                ('serials_to_fields', ctypes.CFUNCTYPE(None, p_long,
+                    ctypes.c_size_t, ctypes.POINTER(Fields))),
+                ('dates_as_serials', ctypes.CFUNCTYPE(None, p_long, p_long,
+                    p_long, ctypes.c_size_t, p_long))
+            ]
+        capi = CAPI.from_address(get_pointer(xldt._C_API, b'xldt._C_API'))
+        self.assertGreaterEqual(capi.version, 1)
+        y, m, d = ctypes.c_long(), ctypes.c_long(), ctypes.c_long()
+        for n in range(-1000, 100000, 97):
+            capi.serial_to_date(n, y, m, d)
+            self.assertEqual((xldt.year(n), xldt.month(n), xldt.day(n)),
+                             (y.value, m.value, d.value))
+            self.assertEqual(n, capi.date_as_serial(y, m, d))
+            self.assertEqual(xldt.weekday(n, xldt.MON_1),
+                             capi.serial_as_weekday(n, xldt.MON_1))
+            self.assertEqual(xldt.isoweek(n),
+                             capi.serial_as_week(n, xldt.MON_2))
+        self.assertGreaterEqual(capi.version, 4)
+        serials = (ctypes.c_long * 500)(*range(40000, 41000, 2))
+        fields = (Fields * 500)()
+        capi.serials_to_fields(serials, 500, fields)
+        self.assertEqual([(xldt.year(n), xldt.month(n), xldt.day(n))
+                          for n in serials],
+                         [(f.year, f.month, f.day) for f in fields])
+        years = (ctypes.c_long * 500)(*(f.year for f in fields))
+        months = (ctypes.c_long * 500)(*(f.month for f in fields))
+        days = (ctypes.c_long * 500)(*(f.day for f in fields))
+        result = (ctypes.c_long * 500)()
+        capi.dates_as_serials(years, months, days, 500, result)
+        self.assertEqual(list(serials), list(result))
+
+    def test_stats(self):
+        xldt.reset_stats()
+        stats = xldt.stats()
+        if not stats:
+            self.skipTest('built without XLDT_STATS')
+        xldt.year(1.5)
+        xldt.year(2)
+        xldt.to_date([1.5, 2])
+        with self.assertRaises(TypeError):
+            xldt.year('2')
+        xldt.isweekend(7, '0000011')
+        xldt.FiscalCalendar().fiscal([1, 2, 3])
+        with self.assertRaises(ValueError):
+            xldt.weekday(7, 99)
+        stats = xldt.stats()
+        self.assertEqual(3, stats['year']['calls'])
+        self.assertEqual(1, stats['year']['converted'])
+        self.assertEqual(1, stats['year']['rejected'])
+        self.assertEqual(0, stats['to_date']['converted'])
+        self.assertEqual(1, stats['isweekend']['slow'])
+        self.assertEqual(1, stats['weekday']['errors'])
+        self.assertEqual(0, stats['weekday']['rejected'])
+        self.assertEqual(1, stats['FiscalCalendar.fiscal']['batches'])
+        self.assertEqual(3, stats['FiscalCalendar.fiscal']['items'])
+        self.assertEqual(0, stats['month']['calls'])
+        xldt.reset_stats()
+        self.assertEqual(0, xldt.stats()['year']['calls'])
+
 if __name__ == '__main__':
     unittest.main()